@@ -60,6 +60,7 @@ struct disk
 
     long long read_cnt;         /* Number of sectors read. */
     long long write_cnt;        /* Number of sectors written. */
+    int64_t busy_ns;            /* Nanoseconds spent in transfers. */
   };
 
 /* An ATA channel (aka controller).
@@ -124,7 +125,7 @@ disk_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
+      lock_init_named (&c->lock, "disk channel");
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
  
@@ -140,6 +141,7 @@ disk_init (void)
           d->capacity = 0;
 
           d->read_cnt = d->write_cnt = 0;
+          d->busy_ns = 0;
         }
 
       /* Register interrupt handler. */
@@ -173,8 +175,8 @@ disk_print_stats (void)
         {
           struct disk *d = disk_get (chan_no, dev_no);
           if (d != NULL && d->is_ata) 
-            printf ("%s: %lld reads, %lld writes\n",
-                    d->name, d->read_cnt, d->write_cnt);
+            printf ("%s: %lld reads, %lld writes, %"PRId64" us busy\n",
+                    d->name, d->read_cnt, d->write_cnt, d->busy_ns / 1000);
         }
     }
 }
@@ -220,12 +222,14 @@ void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) 
 {
   struct channel *c;
+  int64_t start;
   
   ASSERT (d != NULL);
   ASSERT (buffer != NULL);
 
   c = d->channel;
   lock_acquire (&c->lock);
+  start = timer_ns ();
   select_sector (d, sec_no);
   issue_pio_command (c, CMD_READ_SECTOR_RETRY);
   sema_down (&c->completion_wait);
@@ -233,6 +237,7 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer)
     PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
   input_sector (c, buffer);
   d->read_cnt++;
+  d->busy_ns += timer_ns () - start;
   lock_release (&c->lock);
 }
 
@@ -245,12 +250,14 @@ void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer)
 {
   struct channel *c;
+  int64_t start;
   
   ASSERT (d != NULL);
   ASSERT (buffer != NULL);
 
   c = d->channel;
   lock_acquire (&c->lock);
+  start = timer_ns ();
   select_sector (d, sec_no);
   issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
   if (!wait_while_busy (d))
@@ -258,6 +265,7 @@ disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer)
   output_sector (c, buffer);
   sema_down (&c->completion_wait);
   d->write_cnt++;
+  d->busy_ns += timer_ns () - start;
   lock_release (&c->lock);
 }
 
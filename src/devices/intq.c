@@ -11,6 +11,7 @@ void
 intq_init (struct intq *q) 
 {
   lock_init (&q->lock);
+  spinlock_init (&q->spin);
   q->not_full = q->not_empty = NULL;
   q->head = q->tail = 0;
 }
@@ -41,17 +42,21 @@ intq_getc (struct intq *q)
   uint8_t byte;
   
   ASSERT (intr_get_level () == INTR_OFF);
+  spinlock_acquire (&q->spin);
   while (intq_empty (q)) 
     {
       ASSERT (!intr_context ());
+      spinlock_release (&q->spin);
       lock_acquire (&q->lock);
       wait (q, &q->not_empty);
       lock_release (&q->lock);
+      spinlock_acquire (&q->spin);
     }
   
   byte = q->buf[q->tail];
   q->tail = next (q->tail);
   signal (q, &q->not_full);
+  spinlock_release (&q->spin);
   return byte;
 }
 
@@ -63,17 +68,21 @@ void
 intq_putc (struct intq *q, uint8_t byte) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
+  spinlock_acquire (&q->spin);
   while (intq_full (q))
     {
       ASSERT (!intr_context ());
+      spinlock_release (&q->spin);
       lock_acquire (&q->lock);
       wait (q, &q->not_full);
       lock_release (&q->lock);
+      spinlock_acquire (&q->spin);
     }
 
   q->buf[q->head] = byte;
   q->head = next (q->head);
   signal (q, &q->not_empty);
+  spinlock_release (&q->spin);
 }
 
 /* Returns the position after POS within an intq. */
@@ -84,17 +93,24 @@ next (int pos)
 }
 
 /* WAITER must be the address of Q's not_empty or not_full
-   member.  Waits until the given condition is true. */
+   member.  Waits until the given condition is true, unless
+   another CPU already made it true while we were not holding
+   Q's spinlock. */
 static void
-wait (struct intq *q UNUSED, struct thread **waiter) 
+wait (struct intq *q, struct thread **waiter) 
 {
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
-  ASSERT ((waiter == &q->not_empty && intq_empty (q))
-          || (waiter == &q->not_full && intq_full (q)));
+  ASSERT (waiter == &q->not_empty || waiter == &q->not_full);
 
-  *waiter = thread_current ();
-  thread_block ();
+  spinlock_acquire (&q->spin);
+  if (waiter == &q->not_empty ? intq_empty (q) : intq_full (q)) 
+    {
+      *waiter = thread_current ();
+      thread_block_release (&q->spin);
+    }
+  else
+    spinlock_release (&q->spin);
 }
 
 /* WAITER must be the address of Q's not_empty or not_full
@@ -102,9 +118,10 @@ wait (struct intq *q UNUSED, struct thread **waiter)
    thread is waiting for the condition, wakes it up and resets
    the waiting thread. */
 static void
-signal (struct intq *q UNUSED, struct thread **waiter) 
+signal (struct intq *q, struct thread **waiter) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spinlock_held_by_current_cpu (&q->spin));
   ASSERT ((waiter == &q->not_empty && !intq_empty (q))
           || (waiter == &q->not_full && !intq_full (q)));
 
@@ -9,7 +9,8 @@
 
    Interrupt queue functions can be called from kernel threads or
    from external interrupt handlers.  Except for intq_init(),
-   interrupts must be off in either case.
+   interrupts must be off in either case.  A spinlock keeps
+   threads on other CPUs out while the queue is changed.
 
    The interrupt queue has the structure of a "monitor".  Locks
    and condition variables from threads/synch.h cannot be used in
@@ -29,6 +30,7 @@ struct intq
     struct thread *not_empty;   /* Thread waiting for not-empty condition. */
 
     /* Queue. */
+    struct spinlock spin;       /* Protects the waiters and queue. */
     uint8_t buf[INTQ_BUFSIZE];  /* Buffer. */
     int head;                   /* New data is written here. */
     int tail;                   /* Old data is read here. */
@@ -0,0 +1,254 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/timer.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/profile.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* See [IA32-v3a] chapter 8 "Advanced Programmable Interrupt
+   Controller (APIC)" for hardware details of the local APIC.
+
+   Every CPU has its own local APIC, mapped at the same physical
+   address, so the same code reaches whichever one belongs to the
+   CPU running it.  The PICs keep delivering device interrupts
+   to the bootstrap processor only; the local APICs are used for
+   a timer tick on the other CPUs and for inter-processor
+   interrupts (IPIs). */
+
+/* Virtual address of the local APIC's registers: the last page
+   of the address space, above all of the physical memory that
+   is mapped at PHYS_BASE. */
+#define LAPIC_VADDR ((volatile uint32_t *) 0xfffff000)
+
+/* Register offsets, in bytes. */
+#define ID          0x020       /* Local APIC ID. */
+#define TPR         0x080       /* Task priority. */
+#define EOI         0x0b0       /* End of interrupt. */
+#define SVR         0x0f0       /* Spurious interrupt vector. */
+#define ESR         0x280       /* Error status. */
+#define ICR_LO      0x300       /* Interrupt command, bits 0...31. */
+#define ICR_HI      0x310       /* Interrupt command, bits 32...63. */
+#define LVT_TIMER   0x320       /* Local vector table: timer. */
+#define LVT_LINT0   0x350       /* Local vector table: LINT0 pin. */
+#define LVT_LINT1   0x360       /* Local vector table: LINT1 pin. */
+#define TIMER_INIT  0x380       /* Timer initial count. */
+#define TIMER_CUR   0x390       /* Timer current count. */
+#define TIMER_DIV   0x3e0       /* Timer divide configuration. */
+
+/* Register bits. */
+#define SVR_ENABLE      0x100       /* APIC software enable. */
+#define LVT_MASKED      0x10000     /* Interrupt masked. */
+#define LVT_PERIODIC    0x20000     /* Timer mode: periodic. */
+#define TIMER_DIV_16    0x3         /* Timer counts at bus clock / 16. */
+#define ICR_INIT        0x500       /* Delivery mode: INIT. */
+#define ICR_STARTUP     0x600       /* Delivery mode: start-up. */
+#define ICR_PENDING     0x1000      /* Delivery status: send pending. */
+#define ICR_ASSERT      0x4000      /* Level: assert. */
+
+/* Page table entry bits for memory-mapped I/O: page-level write
+   through and cache disable.  See [IA32-v3a] 3.7.6
+   "Page-Directory and Page-Table Entries". */
+#define PTE_PWT 0x8
+#define PTE_PCD 0x10
+
+/* Number of timer ticks the local APIC timer is calibrated
+   over. */
+#define CALIBRATE_TICKS 4
+
+/* Local APIC timer counts per timer tick.
+   Initialized by lapic_timer_calibrate(). */
+static uint32_t timer_count;
+
+static intr_handler_func timer_interrupt, spurious_interrupt;
+static void enable (void);
+
+/* Reads local APIC register REG. */
+static inline uint32_t
+read_reg (unsigned reg)
+{
+  return LAPIC_VADDR[reg / sizeof (uint32_t)];
+}
+
+/* Writes VALUE to local APIC register REG. */
+static inline void
+write_reg (unsigned reg, uint32_t value)
+{
+  LAPIC_VADDR[reg / sizeof (uint32_t)] = value;
+}
+
+/* Maps the local APIC registers, which are at physical address
+   PHYS_ADDR, into the kernel's address space, registers the
+   local APIC interrupts, and enables the bootstrap processor's
+   local APIC.  The LINT0 pin, through which the PICs reach the
+   bootstrap processor, is left as the BIOS set it up. */
+void
+lapic_init (uint32_t phys_addr)
+{
+  void *vaddr = (void *) LAPIC_VADDR;
+  uint32_t *pt;
+
+  ASSERT (phys_addr % PGSIZE == 0);
+
+  if (base_page_dir[pd_no (vaddr)] == 0)
+    {
+      pt = palloc_get_page (PAL_ASSERT | PAL_ZERO | PAL_KERNEL_PD);
+      base_page_dir[pd_no (vaddr)] = pde_create (pt);
+    }
+  else
+    pt = pde_get_pt (base_page_dir[pd_no (vaddr)]);
+  pt[pt_no (vaddr)] = phys_addr | PTE_P | PTE_W | PTE_PWT | PTE_PCD;
+  asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+
+  intr_register_ext (LAPIC_TIMER_VEC, timer_interrupt, "Local APIC timer");
+  intr_register_int (LAPIC_SPURIOUS_VEC, 0, INTR_OFF, spurious_interrupt,
+                     "Spurious APIC interrupt");
+  enable ();
+}
+
+/* Enables the local APIC of the application processor that
+   calls it.  LINT0 and LINT1 are masked, so that device
+   interrupts from the PICs only reach the bootstrap
+   processor. */
+void
+lapic_init_ap (void)
+{
+  write_reg (LVT_LINT0, LVT_MASKED);
+  write_reg (LVT_LINT1, LVT_MASKED);
+  enable ();
+}
+
+/* Returns the local APIC ID of the running CPU. */
+uint8_t
+lapic_id (void)
+{
+  return read_reg (ID) >> 24;
+}
+
+/* Signals the end of a local APIC interrupt. */
+void
+lapic_eoi (void)
+{
+  write_reg (EOI, 0);
+}
+
+/* Sends an IPI with the given ICR low word to the CPU whose
+   local APIC ID is APIC_ID, and waits until it has been
+   delivered. */
+static void
+send_icr (uint8_t apic_id, uint32_t icr_lo)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  write_reg (ICR_HI, (uint32_t) apic_id << 24);
+  write_reg (ICR_LO, icr_lo);
+  while (read_reg (ICR_LO) & ICR_PENDING)
+    barrier ();
+}
+
+/* Sends an INIT IPI to APIC_ID, resetting that CPU into its
+   wait-for-startup state. */
+void
+lapic_send_init (uint8_t apic_id)
+{
+  enum intr_level old_level = intr_disable ();
+  send_icr (apic_id, ICR_INIT | ICR_ASSERT);
+  intr_set_level (old_level);
+}
+
+/* Sends a start-up IPI to APIC_ID, which starts that CPU in
+   real mode at PHYS_ADDR, which must be page-aligned and below
+   1 MB. */
+void
+lapic_send_startup (uint8_t apic_id, uint32_t phys_addr)
+{
+  enum intr_level old_level;
+
+  ASSERT (phys_addr % PGSIZE == 0 && phys_addr < 0x100000);
+
+  old_level = intr_disable ();
+  send_icr (apic_id, ICR_STARTUP | ICR_ASSERT | (phys_addr >> 12));
+  intr_set_level (old_level);
+}
+
+/* Sends interrupt VEC to the CPU whose local APIC ID is
+   APIC_ID.  Interrupts must be off. */
+void
+lapic_send_ipi (uint8_t apic_id, uint8_t vec)
+{
+  send_icr (apic_id, ICR_ASSERT | vec);
+}
+
+/* Measures how fast the local APIC timer counts, using the
+   timer ticks as a reference.  All local APIC timers run from
+   the same bus clock, so the bootstrap processor can do this
+   for everyone. */
+void
+lapic_timer_calibrate (void)
+{
+  int64_t start;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  write_reg (TIMER_DIV, TIMER_DIV_16);
+  write_reg (LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+
+  /* Wait for a tick edge, then count down over a few ticks. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    barrier ();
+  write_reg (TIMER_INIT, 0xffffffff);
+  start = timer_ticks ();
+  while (timer_ticks () - start < CALIBRATE_TICKS)
+    barrier ();
+  timer_count = (0xffffffff - read_reg (TIMER_CUR)) / CALIBRATE_TICKS;
+  write_reg (TIMER_INIT, 0);
+
+  ASSERT (timer_count > 0);
+}
+
+/* Starts the calling CPU's local APIC timer interrupting
+   TIMER_FREQ times per second. */
+void
+lapic_timer_start (void)
+{
+  ASSERT (timer_count > 0);
+
+  write_reg (TIMER_DIV, TIMER_DIV_16);
+  write_reg (LVT_TIMER, LVT_PERIODIC | LAPIC_TIMER_VEC);
+  write_reg (TIMER_INIT, timer_count);
+}
+
+/* Software-enables the local APIC, with spurious interrupts
+   going to LAPIC_SPURIOUS_VEC, and lets it accept interrupts
+   of all priorities. */
+static void
+enable (void)
+{
+  write_reg (ESR, 0);
+  write_reg (TPR, 0);
+  write_reg (SVR, (read_reg (SVR) & ~0xff) | SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+}
+
+/* Local APIC timer interrupt handler.  Only application
+   processors run the local APIC timer; the bootstrap processor
+   keeps its tick from the 8254 (see devices/timer.c). */
+static void
+timer_interrupt (struct intr_frame *args)
+{
+  profile_sample (args);
+  thread_tick ();
+}
+
+/* Spurious local APIC interrupts need neither handling nor an
+   end-of-interrupt signal. */
+static void
+spurious_interrupt (struct intr_frame *args UNUSED)
+{
+}
@@ -0,0 +1,25 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdint.h>
+
+/* Interrupt vectors delivered by the local APIC.  They lie
+   outside both the PIC's range (0x20...0x2f) and the system
+   call vector (0x30). */
+#define LAPIC_TIMER_VEC 0x40    /* Local APIC timer. */
+#define LAPIC_RESCHED_VEC 0x41  /* Reschedule IPI, see cpu_kick(). */
+#define LAPIC_SPURIOUS_VEC 0xff /* Spurious interrupts. */
+
+void lapic_init (uint32_t phys_addr);
+void lapic_init_ap (void);
+uint8_t lapic_id (void);
+void lapic_eoi (void);
+
+void lapic_send_init (uint8_t apic_id);
+void lapic_send_startup (uint8_t apic_id, uint32_t phys_addr);
+void lapic_send_ipi (uint8_t apic_id, uint8_t vec);
+
+void lapic_timer_calibrate (void);
+void lapic_timer_start (void);
+
+#endif /* devices/lapic.h */
@@ -1,10 +1,14 @@
 #include "devices/timer.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stdio.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/profile.h"
+#include "threads/spinlock.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
   
@@ -17,15 +21,98 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
-/* Number of timer ticks since OS booted. */
+/* 8254 input frequency divided by TIMER_FREQ, rounded to
+   nearest: the number of PIT input clocks in one timer tick. */
+#define TICK_COUNT ((1193180 + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest one-shot countdown, in whole ticks, that fits in the
+   8254's 16-bit counter. */
+#define MAX_IDLE_TICKS (0xffff / TICK_COUNT)
+
+/* Nanoseconds per timer tick. */
+#define NS_PER_TICK (1000000000 / TIMER_FREQ)
+
+/* Number of timer ticks timer_calibrate() measures over. */
+#define CALIBRATE_TICKS 4
+
+/* Number of busy_wait() loops run between checks of the clock
+   while calibrating. */
+#define CALIBRATE_CHUNK 64
+
+/* 8254 counter 0 operating modes, as control words. */
+#define PIT_ONESHOT 0x30        /* CW: counter 0, LSB then MSB, mode 0. */
+#define PIT_PERIODIC 0x34       /* CW: counter 0, LSB then MSB, mode 2. */
+
+/* Number of timer ticks since OS booted.  Only the bootstrap
+   processor takes 8254 interrupts, so only it changes this. */
 static int64_t ticks;
 
 /* Number of loops per timer tick.
-   Initialized by timer_calibrate(). */
+   Initialized by timer_calibrate(), unless preset with
+   timer_set_loops_per_tick(). */
 static unsigned loops_per_tick;
 
+/* Number of CPU time-stamp counter cycles per timer tick, and
+   the TSC value that corresponds to tick 0.
+   Initialized by timer_calibrate(), unless preset with
+   timer_set_tsc_per_tick(); until then the clock falls back to
+   tick resolution. */
+static uint64_t tsc_per_tick;
+static uint64_t tsc_boot;
+
+/* TSC value read at the most recent timer interrupt. */
+static uint64_t tick_tsc;
+
+/* Threads blocked in timer_sleep(), in order of increasing
+   wakeup_tick, and the spinlock that protects the list. */
+static struct list sleep_list;
+static struct spinlock sleep_lock;
+
+/* Tickless idle.  When the idle thread has nothing to do, the
+   periodic tick is replaced by a single one-shot countdown that
+   ends at the next sleeper's deadline (or after MAX_IDLE_TICKS).
+   TICK_STOPPED means that countdown is running.  If another
+   interrupt wakes the CPU first, the whole ticks that passed are
+   accounted for and a short TICK_RESYNC countdown re-aligns the
+   next interrupt with the original tick boundary, so the tick
+   count never drifts. */
+enum tick_mode
+  {
+    TICK_PERIODIC,              /* Normal periodic interrupts. */
+    TICK_STOPPED,               /* Idle one-shot countdown running. */
+    TICK_RESYNC                 /* Countdown to the next tick boundary. */
+  };
+static enum tick_mode tick_mode;
+static int64_t stopped_ticks;   /* Ticks covered by the idle countdown. */
+static unsigned stopped_count;  /* PIT count loaded for the countdown. */
+static unsigned stopped_phase;  /* PIT clocks of the tick already elapsed. */
+static long long stopped_cnt;   /* # of times the periodic tick stopped. */
+
+/* States of a timed wait, kept in struct thread's `wait_state'.
+
+   A thread in a timed wait is on two lists at once: the wait
+   queue of whatever it waits for, and the sleep list.  Whichever
+   of its waker and the timer gets to it first moves it out of
+   WAIT_BLOCKED with an atomic compare-and-swap and unblocks it;
+   the other one then leaves it alone.  The thread itself takes
+   itself off whichever list the winner did not. */
+enum wait_state
+  {
+    WAIT_NONE,                  /* Not in a timed wait. */
+    WAIT_BLOCKED,               /* Blocked until woken or timed out. */
+    WAIT_WOKEN,                 /* Woken by timer_wakeup(). */
+    WAIT_TIMED_OUT              /* Woken by the timer. */
+  };
+
 static intr_handler_func timer_interrupt;
-static bool too_many_loops (unsigned loops);
+static uint64_t rdtsc (void);
+static void calibrate (void);
+static void pit_program (uint8_t mode, unsigned count);
+static bool pit_read_back (unsigned *count);
+static void wake_sleepers (void);
+static inline bool compare_and_swap (volatile int *, int old, int new);
+static bool wakeup_less (const struct list_elem *, const struct list_elem *,
+                         void *aux);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 
@@ -35,42 +122,64 @@ static void real_time_sleep (int64_t num, int32_t denom);
 void
 timer_init (void) 
 {
-  /* 8254 input frequency divided by TIMER_FREQ, rounded to
-     nearest. */
-  uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-  outb (0x40, count & 0xff);
-  outb (0x40, count >> 8);
+  list_init (&sleep_list);
+  spinlock_init (&sleep_lock);
+  pit_program (PIT_PERIODIC, TICK_COUNT);
+  tick_mode = TICK_PERIODIC;
 
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Presets the number of busy-wait loops per timer tick to LPT,
+   so that timer_calibrate() need not measure it.  Must be called
+   before timer_calibrate(). */
+void
+timer_set_loops_per_tick (unsigned lpt) 
+{
+  loops_per_tick = lpt;
+}
+
+/* Presets the number of TSC cycles per timer tick to TPT, so
+   that timer_calibrate() need not measure it.  Must be called
+   before timer_calibrate(). */
+void
+timer_set_tsc_per_tick (uint64_t tpt) 
+{
+  tsc_per_tick = tpt;
+}
+
+/* Calibrates loops_per_tick, used to implement brief delays, and
+   the TSC rate, used by timer_ns().  Values preset from the
+   kernel command line are kept as they are.  The final line
+   printed gives the options that skip calibration on the next
+   boot of the same machine. */
 void
 timer_calibrate (void) 
 {
-  unsigned high_bit, test_bit;
+  enum intr_level old_level;
+  int64_t start;
 
   ASSERT (intr_get_level () == INTR_ON);
   printf ("Calibrating timer...  ");
 
-  /* Approximate loops_per_tick as the largest power-of-two
-     still less than one timer tick. */
-  loops_per_tick = 1u << 10;
-  while (!too_many_loops (loops_per_tick << 1)) 
+  if (loops_per_tick == 0 || tsc_per_tick == 0)
+    calibrate ();
+  else 
     {
-      loops_per_tick <<= 1;
-      ASSERT (loops_per_tick != 0);
-    }
+      /* Only anchor the TSC to a tick boundary. */
+      start = ticks;
+      while (ticks == start)
+        barrier ();
 
-  /* Refine the next 8 bits of loops_per_tick. */
-  high_bit = loops_per_tick;
-  for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-    if (!too_many_loops (high_bit | test_bit))
-      loops_per_tick |= test_bit;
+      old_level = intr_disable ();
+      tsc_boot = tick_tsc - (uint64_t) ticks * tsc_per_tick;
+      intr_set_level (old_level);
+    }
 
-  printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+  printf ("%'"PRIu64" loops/s, %'"PRIu64" cycles/s "
+          "(-lpt=%u -tsc=%"PRIu64").\n",
+          (uint64_t) loops_per_tick * TIMER_FREQ, tsc_per_tick * TIMER_FREQ,
+          loops_per_tick, tsc_per_tick);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -78,9 +187,18 @@ int64_t
 timer_ticks (void) 
 {
   enum intr_level old_level = intr_disable ();
-  int64_t t = ticks;
+  int64_t t;
+
+  /* Disabling interrupts does not stop the bootstrap processor
+     from updating TICKS while another CPU reads its two halves,
+     so read until two reads agree. */
+  do 
+    {
+      t = ticks;
+      barrier ();
+    }
+  while (t != ticks);
   intr_set_level (old_level);
-  barrier ();
   return t;
 }
 
@@ -92,15 +210,136 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
+/* Returns the current value of the CPU's time-stamp counter.
+   Useful for timing short intervals cheaply; convert a
+   difference of two values with timer_cycles_to_ns(). */
+uint64_t
+timer_cycles (void) 
+{
+  return rdtsc ();
+}
+
+/* Converts CYCLES time-stamp counter cycles into nanoseconds.
+   Returns 0 if the TSC has not been calibrated yet. */
+int64_t
+timer_cycles_to_ns (uint64_t cycles) 
+{
+  if (tsc_per_tick == 0)
+    return 0;
+
+  /* Split CYCLES into whole ticks and a remainder, so that the
+     multiplication cannot overflow. */
+  return (cycles / tsc_per_tick * NS_PER_TICK
+          + cycles % tsc_per_tick * NS_PER_TICK / tsc_per_tick);
+}
+
+/* Returns the number of nanoseconds since the OS booted.  The
+   clock is monotonic.  It has the resolution of the CPU's
+   time-stamp counter once timer_calibrate() has run, and timer
+   tick resolution before that. */
+int64_t
+timer_ns (void) 
+{
+  if (tsc_per_tick == 0)
+    return timer_ticks () * NS_PER_TICK;
+  return timer_cycles_to_ns (rdtsc () - tsc_boot);
+}
+
 /* Suspends execution for approximately TICKS timer ticks. */
 void
 timer_sleep (int64_t ticks) 
 {
-  int64_t start = timer_ticks ();
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks) 
-    thread_yield (); /* BUSY WAIT. Unacceptable. For you to fix. */
+  if (ticks <= 0)
+    return;
+
+  old_level = intr_disable ();
+  cur->wakeup_tick = timer_ticks () + ticks;
+  spinlock_acquire (&sleep_lock);
+  list_insert_ordered (&sleep_list, &cur->sleep_elem, wakeup_less, NULL);
+
+  /* The bootstrap processor may have stopped its tick until
+     some later deadline.  Make it look again. */
+  if (list_front (&sleep_list) == &cur->sleep_elem)
+    cpu_kick (&cpus[0]);
+  thread_block_release (&sleep_lock);
+  intr_set_level (old_level);
+}
+
+/* Blocks the current thread, which the caller has put on a wait
+   queue protected by LOCK, until timer_wakeup() wakes it or the
+   timer reaches tick DEADLINE, whichever comes first.  Releases
+   LOCK like thread_block_release().  Returns true if the thread
+   was woken, false if it timed out.
+
+   After a timeout, the caller must reacquire LOCK and call
+   timer_wait_finish() to find out whether the thread is still on
+   the wait queue.  Interrupts must be off. */
+bool
+timer_block_release (struct spinlock *lock, int64_t deadline) 
+{
+  struct thread *cur = thread_current ();
+  bool woken;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spinlock_held_by_current_cpu (lock));
+
+  cur->wakeup_tick = deadline;
+  cur->wait_state = WAIT_BLOCKED;
+  spinlock_acquire (&sleep_lock);
+  list_insert_ordered (&sleep_list, &cur->sleep_elem, wakeup_less, NULL);
+  if (list_front (&sleep_list) == &cur->sleep_elem)
+    cpu_kick (&cpus[0]);
+  thread_block_release2 (lock, &sleep_lock);
+
+  /* If the waker got here first, the timer has left us on the
+     sleep list. */
+  woken = cur->wait_state == WAIT_WOKEN;
+  if (woken) 
+    {
+      spinlock_acquire (&sleep_lock);
+      list_remove (&cur->sleep_elem);
+      spinlock_release (&sleep_lock);
+      cur->wait_state = WAIT_NONE;
+    }
+  return woken;
+}
+
+/* Wakes up T, which the caller has just removed from a wait
+   queue while holding the queue's lock, and returns true.  If T
+   is in a timed wait that has already timed out, T has been
+   woken up already, so this only records that T is no longer on
+   the queue and returns false; the caller should then wake up
+   the next waiter instead, if any. */
+bool
+timer_wakeup (struct thread *t) 
+{
+  if (t->wait_state == WAIT_NONE
+      || compare_and_swap (&t->wait_state, WAIT_BLOCKED, WAIT_WOKEN)) 
+    {
+      thread_unblock (t);
+      return true;
+    }
+  ASSERT (t->wait_state == WAIT_TIMED_OUT);
+  t->wait_state = WAIT_NONE;
+  return false;
+}
+
+/* Ends the current thread's timed wait after it timed out and
+   reacquired the lock it passed to timer_block_release().
+   Returns true if the thread is still on that lock's wait queue,
+   in which case the caller must remove it. */
+bool
+timer_wait_finish (void) 
+{
+  struct thread *cur = thread_current ();
+  bool queued = cur->wait_state == WAIT_TIMED_OUT;
+
+  cur->wait_state = WAIT_NONE;
+  return queued;
 }
 
 /* Suspends execution for approximately MS milliseconds. */
@@ -124,38 +363,252 @@ timer_nsleep (int64_t ns)
   real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* Stops the periodic timer interrupt until the next sleeping
+   thread is due, because nothing is ready to run.  Called by the
+   idle thread, with interrupts off, just before it halts the
+   CPU.  Does nothing if the next tick is due first anyway. */
+void
+timer_stop_tick (void) 
+{
+  int64_t delta = MAX_IDLE_TICKS;
+  unsigned remaining;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (tick_mode != TICK_PERIODIC)
+    return;
+
+  spinlock_acquire (&sleep_lock);
+  if (!list_empty (&sleep_list)) 
+    {
+      struct thread *t = list_entry (list_front (&sleep_list),
+                                     struct thread, sleep_elem);
+      if (t->wakeup_tick - ticks < delta)
+        delta = t->wakeup_tick - ticks;
+    }
+  spinlock_release (&sleep_lock);
+  if (delta < 2)
+    return;
+
+  /* Count down the rest of the current tick plus DELTA - 1 whole
+     ticks, so that the countdown ends on a tick boundary. */
+  pit_read_back (&remaining);
+  if (remaining == 0 || remaining > TICK_COUNT)
+    return;
+  stopped_phase = TICK_COUNT - remaining;
+  stopped_ticks = delta;
+  stopped_count = remaining + (delta - 1) * TICK_COUNT;
+  pit_program (PIT_ONESHOT, stopped_count);
+  tick_mode = TICK_STOPPED;
+  stopped_cnt++;
+}
+
+/* Restarts the periodic timer interrupt after the idle thread
+   was woken by some interrupt other than the timer, adding the
+   ticks that elapsed meanwhile to the tick count.  Called by the
+   idle thread with interrupts off. */
+void
+timer_resume_tick (void) 
+{
+  unsigned remaining, elapsed;
+  int64_t passed;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (tick_mode != TICK_STOPPED)
+    return;
+
+  /* If the countdown already ran out, the timer interrupt is
+     pending and will do the accounting itself. */
+  if (pit_read_back (&remaining))
+    return;
+
+  elapsed = stopped_phase + (stopped_count - remaining);
+  passed = elapsed / TICK_COUNT;
+  ticks += passed;
+  wake_sleepers ();
+
+  pit_program (PIT_ONESHOT, TICK_COUNT - elapsed % TICK_COUNT);
+  tick_mode = TICK_RESYNC;
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) 
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRId64" ticks, %"PRId64" ms, "
+          "periodic tick stopped %lld times\n",
+          timer_ticks (), timer_ns () / 1000000, stopped_cnt);
 }
 
 /* Timer interrupt handler. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+timer_interrupt (struct intr_frame *args)
 {
+  /* A one-shot countdown ran out: account for the whole idle
+     period and go back to periodic interrupts.  An interrupt that
+     arrives while the countdown is still running is a periodic
+     tick that was already pending when the tick was stopped. */
+  if (tick_mode != TICK_PERIODIC && pit_read_back (NULL)) 
+    {
+      if (tick_mode == TICK_STOPPED) 
+        ticks += stopped_ticks - 1;
+      pit_program (PIT_PERIODIC, TICK_COUNT);
+      tick_mode = TICK_PERIODIC;
+    }
+
+  tick_tsc = rdtsc ();
   ticks++;
+  wake_sleepers ();
+  profile_sample (args);
   thread_tick ();
 }
 
-/* Returns true if LOOPS iterations waits for more than one timer
-   tick, otherwise false. */
-static bool
-too_many_loops (unsigned loops) 
+/* Reads the CPU's time-stamp counter.  See [IA32-v2b]
+   "RDTSC". */
+static uint64_t
+rdtsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Measures, over a single window of CALIBRATE_TICKS timer
+   ticks, the number of time-stamp counter cycles per tick and
+   the number of busy_wait() loops per tick, skipping whichever
+   of the two was preset.  The TSC values are the ones the timer
+   interrupt read at the window's edges, so the window's length
+   is exact; the loop rate is the loops run per TSC cycle.
+   Also anchors the TSC to the tick count so that timer_ns()
+   stays monotonic. */
+static void
+calibrate (void) 
 {
-  /* Wait for a timer tick. */
-  int64_t start = ticks;
+  enum intr_level old_level;
+  int64_t start, end;
+  uint64_t tsc_start, tsc_end, loop_start, loop_cycles;
+  uint64_t loops = 0;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  /* Wait for a tick edge. */
+  start = ticks;
   while (ticks == start)
     barrier ();
 
-  /* Run LOOPS loops. */
+  old_level = intr_disable ();
   start = ticks;
-  busy_wait (loops);
+  tsc_start = tick_tsc;
+  intr_set_level (old_level);
+
+  /* Run the busy loop in chunks until the window closes. */
+  loop_start = rdtsc ();
+  while (ticks - start < CALIBRATE_TICKS)
+    {
+      busy_wait (CALIBRATE_CHUNK);
+      loops += CALIBRATE_CHUNK;
+    }
+  loop_cycles = rdtsc () - loop_start;
+
+  old_level = intr_disable ();
+  end = ticks;
+  tsc_end = tick_tsc;
+  if (tsc_per_tick == 0)
+    tsc_per_tick = (tsc_end - tsc_start) / (end - start);
+  tsc_boot = tsc_end - (uint64_t) end * tsc_per_tick;
+  intr_set_level (old_level);
 
-  /* If the tick count changed, we iterated too long. */
-  barrier ();
-  return start != ticks;
+  if (loops_per_tick == 0) 
+    {
+      loops_per_tick = loops * tsc_per_tick / loop_cycles;
+      if (loops_per_tick == 0)
+        loops_per_tick = 1;
+    }
+}
+
+/* Loads COUNT into 8254 counter 0 and starts it in MODE, one of
+   PIT_ONESHOT or PIT_PERIODIC.  See [8254] for details. */
+static void
+pit_program (uint8_t mode, unsigned count) 
+{
+  ASSERT (count > 0 && count <= 0xffff);
+
+  outb (0x43, mode);
+  outb (0x40, count & 0xff);
+  outb (0x40, count >> 8);
+}
+
+/* Latches the state of 8254 counter 0 with a read-back command,
+   stores its current count into *COUNT if COUNT is non-null,
+   and returns the state of its OUT pin.  In one-shot mode OUT
+   goes high exactly when the countdown runs out. */
+static bool
+pit_read_back (unsigned *count) 
+{
+  uint8_t status, lsb, msb;
+
+  outb (0x43, 0xc2);    /* Read-back: latch count and status of counter 0. */
+  status = inb (0x40);
+  lsb = inb (0x40);
+  msb = inb (0x40);
+  if (count != NULL)
+    *count = lsb | (msb << 8);
+  return (status & 0x80) != 0;
+}
+
+/* Unblocks every sleeping thread whose wakeup time has come.
+   Interrupts must be off. */
+static void
+wake_sleepers (void) 
+{
+  struct list_elem *e;
+
+  spinlock_acquire (&sleep_lock);
+  e = list_begin (&sleep_list);
+  while (e != list_end (&sleep_list)) 
+    {
+      struct thread *t = list_entry (e, struct thread, sleep_elem);
+      if (t->wakeup_tick > ticks)
+        break;
+
+      /* A timed wait whose waker got there first takes itself
+         off the list. */
+      if (t->wait_state != WAIT_NONE
+          && !compare_and_swap (&t->wait_state,
+                                WAIT_BLOCKED, WAIT_TIMED_OUT)) 
+        {
+          e = list_next (e);
+          continue;
+        }
+      e = list_remove (e);
+      thread_unblock (t);
+    }
+  spinlock_release (&sleep_lock);
+}
+
+/* Atomically replaces *P by NEW if it equals OLD.  Returns true
+   if it did.  See [IA32-v2a] "CMPXCHG". */
+static inline bool
+compare_and_swap (volatile int *p, int old, int new) 
+{
+  int prev;
+
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*p)
+                : "r" (new), "0" (old)
+                : "memory");
+  return prev == old;
+}
+
+/* Returns true if the thread owning sleep list element A_ wakes
+   up before the one owning B_. */
+static bool
+wakeup_less (const struct list_elem *a_, const struct list_elem *b_,
+             void *aux UNUSED) 
+{
+  const struct thread *a = list_entry (a_, struct thread, sleep_elem);
+  const struct thread *b = list_entry (b_, struct thread, sleep_elem);
+
+  return a->wakeup_tick < b->wakeup_tick;
 }
 
 /* Iterates through a simple loop LOOPS times, for implementing
@@ -192,11 +645,21 @@ real_time_sleep (int64_t num, int32_t denom)
          processes. */                
       timer_sleep (ticks); 
     }
+  else if (tsc_per_tick != 0) 
+    {
+      /* Otherwise, spin on the time-stamp counter for accurate
+         sub-tick timing.  NUM * TIMER_FREQ < DENOM here, so the
+         product cannot overflow. */
+      uint64_t start = rdtsc ();
+      uint64_t cycles = tsc_per_tick * (num * TIMER_FREQ) / denom;
+      while (rdtsc () - start < cycles)
+        barrier ();
+    }
   else 
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing.  We scale the numerator and denominator
-         down by 1000 to avoid the possibility of overflow. */
+      /* Before the TSC is calibrated, use a busy-wait loop.  We
+         scale the numerator and denominator down by 1000 to
+         avoid the possibility of overflow. */
       ASSERT (denom % 1000 == 0);
       busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
     }
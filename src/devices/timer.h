@@ -2,22 +2,39 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
+struct spinlock;
+struct thread;
+
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
 void timer_init (void);
 void timer_calibrate (void);
+void timer_set_loops_per_tick (unsigned lpt);
+void timer_set_tsc_per_tick (uint64_t tpt);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
 
+uint64_t timer_cycles (void);
+int64_t timer_cycles_to_ns (uint64_t cycles);
+int64_t timer_ns (void);
+
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+bool timer_block_release (struct spinlock *, int64_t deadline);
+bool timer_wakeup (struct thread *);
+bool timer_wait_finish (void);
+
+void timer_stop_tick (void);
+void timer_resume_tick (void);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
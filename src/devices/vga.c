@@ -5,6 +5,7 @@
 #include <string.h>
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/spinlock.h"
 #include "threads/vaddr.h"
 
 /* VGA text screen support.  See [FREEVGA] for more information. */
@@ -25,6 +26,11 @@ static size_t cx, cy;
    The attribute at (x,y) is fb[y][x][1]. */
 static uint8_t (*fb)[COL_CNT][2];
 
+/* Keeps other CPUs out of the display.  All-zero bytes, as in a
+   static variable, are an unlocked spinlock, so this works even
+   before anything is initialized. */
+static struct spinlock vga_lock;
+
 static void clear_row (size_t y);
 static void cls (void);
 static void newline (void);
@@ -54,6 +60,7 @@ vga_putc (int c)
      that might write to the console. */
   enum intr_level old_level = intr_disable ();
 
+  spinlock_acquire (&vga_lock);
   init ();
   
   switch (c) 
@@ -92,6 +99,7 @@ vga_putc (int c)
   /* Update cursor position. */
   move_cursor ();
 
+  spinlock_release (&vga_lock);
   intr_set_level (old_level);
 }
 
@@ -0,0 +1,115 @@
+/* futex_pingpong.c
+
+   Two processes take turns incrementing a counter kept in a
+   file, each blocking with futex_wait() until it is its turn
+   and waking the other with futex_wake(), with no polling.
+   Reports how long the round trips took.
+
+   Usage: futex_pingpong [ROUNDS]   (default: 1000)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+#define FILE_NAME "futex.1"
+
+static int get (int fd);
+static void put (int fd, int value);
+static void play (int fd, int me, int rounds);
+
+int
+main (int argc, char *argv[])
+{
+  char child_cmd[32];
+  int64_t start, end;
+  int rounds = 1000;
+  int counter;
+  pid_t child;
+  int fd;
+
+  /* The child gets "-" and the number of rounds. */
+  if (argc == 3 && argv[1][0] == '-')
+    {
+      fd = open (FILE_NAME);
+      if (fd < 0)
+        return -1;
+      play (fd, 1, atoi (argv[2]));
+      return 0;
+    }
+
+  if (argc > 1)
+    rounds = atoi (argv[1]);
+  if (rounds < 1)
+    {
+      printf ("Usage: %s [ROUNDS]\n", argv[0]);
+      return -1;
+    }
+
+  create (FILE_NAME, sizeof (int));
+  fd = open (FILE_NAME);
+  if (fd < 0)
+    {
+      printf ("futex_pingpong: could not open %s\n", FILE_NAME);
+      return -1;
+    }
+  put (fd, 0);
+
+  start = clock_gettime ();
+  snprintf (child_cmd, sizeof child_cmd, "futex_pingpong - %d", rounds);
+  child = exec (child_cmd);
+  if (child == PID_ERROR)
+    {
+      printf ("futex_pingpong: could not start child\n");
+      return -1;
+    }
+  play (fd, 0, rounds);
+  wait (child);
+  end = clock_gettime ();
+
+  counter = get (fd);
+  close (fd);
+  remove (FILE_NAME);
+
+  printf ("futex_pingpong: %d round trips in %lld us, counter %d\n",
+          rounds, (end - start) / 1000, counter);
+  return counter == 2 * rounds ? 0 : -1;
+}
+
+/* Returns the counter in file FD. */
+static int
+get (int fd)
+{
+  int value;
+
+  seek (fd, 0);
+  if (read (fd, &value, sizeof value) != sizeof value)
+    return -1;
+  return value;
+}
+
+/* Sets the counter in file FD to VALUE. */
+static void
+put (int fd, int value)
+{
+  seek (fd, 0);
+  write (fd, &value, sizeof value);
+}
+
+/* Increments the counter in file FD whenever it is even, for
+   player ME = 0, or odd, for player ME = 1, ROUNDS times. */
+static void
+play (int fd, int me, int rounds)
+{
+  int i;
+
+  for (i = 0; i < rounds; i++)
+    {
+      int value;
+
+      while ((value = get (fd)) % 2 != me)
+        futex_wait (fd, 0, value);
+      put (fd, value + 1);
+      futex_wake (fd, 0, 1);
+    }
+}
@@ -0,0 +1,52 @@
+/* parmatmult.c
+
+   Runs N copies of matmult at the same time and reports how long
+   they took together, as a CPU-bound benchmark for SMP.  Compare
+   the time with `pintos --smp=1' against `pintos --smp=N'.
+
+   Usage: parmatmult [N]   (default: 4)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+#define MAX_CHILDREN 16
+
+int
+main (int argc, char *argv[])
+{
+  pid_t children[MAX_CHILDREN];
+  int64_t start, end;
+  int n = 4;
+  int started, i;
+  int failed = 0;
+
+  if (argc > 1)
+    n = atoi (argv[1]);
+  if (n < 1 || n > MAX_CHILDREN)
+    {
+      printf ("Usage: %s [N]   (1 <= N <= %d)\n", argv[0], MAX_CHILDREN);
+      return -1;
+    }
+
+  start = clock_gettime ();
+  for (started = 0; started < n; started++)
+    {
+      children[started] = exec ("matmult");
+      if (children[started] == PID_ERROR)
+        {
+          printf ("parmatmult: could not start matmult #%d\n", started);
+          break;
+        }
+    }
+
+  for (i = 0; i < started; i++)
+    if (wait (children[i]) == -1)
+      failed++;
+  end = clock_gettime ();
+
+  printf ("parmatmult: %d matmult processes in %lld us (%d failed)\n",
+          started, (end - start) / 1000, failed);
+  return started == n && failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,76 @@
+/* spawnbench.c
+
+   Measures exec+wait throughput by spawning many short-lived
+   children: first one at a time, each waited for before the next
+   is started, then in batches of several running at once.  Each
+   child is `dummy', which just exits with its argument, so the
+   times are mostly process creation and teardown.
+
+   pintos -v -k --fs-disk=2 --qemu -p ../examples/spawnbench -a spawnbench -p ../examples/dummy -a dummy -- -f -q run 'spawnbench 2000 16'
+
+   Usage: spawnbench [COUNT [BATCH]]   (default: 1000 16)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+#define MAX_BATCH 64
+
+static int run (int count, int batch);
+
+int
+main (int argc, char *argv[])
+{
+  int count = argc > 1 ? atoi (argv[1]) : 1000;
+  int batch = argc > 2 ? atoi (argv[2]) : 16;
+  int failed;
+
+  if (count < 1 || batch < 1 || batch > MAX_BATCH)
+    {
+      printf ("Usage: %s [COUNT [BATCH]]   (1 <= BATCH <= %d)\n",
+              argv[0], MAX_BATCH);
+      return -1;
+    }
+
+  failed = run (count, 1);
+  failed += run (count, batch);
+  return failed == 0 ? 0 : -1;
+}
+
+/* Spawns COUNT children, BATCH at a time, and waits for each
+   batch before starting the next.  Prints the throughput and
+   returns the number of children that failed. */
+static int
+run (int count, int batch)
+{
+  pid_t children[MAX_BATCH];
+  char cmd[16];
+  int64_t start, elapsed;
+  int done, started, i;
+  int failed = 0;
+
+  start = clock_gettime ();
+  for (done = 0; done < count; done += started)
+    {
+      for (started = 0; started < batch && done + started < count; started++)
+        {
+          int arg = (done + started) % 100;
+
+          snprintf (cmd, sizeof cmd, "dummy %d", arg);
+          children[started] = exec (cmd);
+        }
+      for (i = 0; i < started; i++)
+        if (children[i] == PID_ERROR
+            || wait (children[i]) != (done + i) % 100)
+          failed++;
+    }
+  elapsed = clock_gettime () - start;
+
+  printf ("spawnbench: %d children, %d at a time, in %lld ms: "
+          "%lld exec+wait/s, %d failed\n",
+          count, batch, elapsed / 1000000,
+          elapsed > 0 ? (int64_t) count * 1000000000 / elapsed : 0,
+          failed);
+  return failed;
+}
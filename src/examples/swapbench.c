@@ -0,0 +1,56 @@
+/* swapbench.c
+
+   Uses more memory than the kernel lets user processes have, so
+   that pages must be evicted and swapped.  Each pass writes to
+   every page of a 2 MB array and then reads them all back and
+   checks them, and the time of each pass is reported.  Run
+   `matmult' copies at the same time to add competition for
+   memory.  The kernel prints page fault, eviction and swap I/O
+   counts when it powers off.
+
+   pintos -v -k --fs-disk=2 --swap-disk=4 --qemu -p ../examples/swapbench -a swapbench -- -f -ul=128 -q run 'swapbench 4'
+
+   Usage: swapbench [PASSES]   (default: 2)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 512
+
+static char pages[PAGE_CNT][PAGE_SIZE];
+
+int
+main (int argc, char *argv[])
+{
+  int passes = argc > 1 ? atoi (argv[1]) : 2;
+  int pass, i;
+  int bad = 0;
+
+  if (passes < 1)
+    {
+      printf ("Usage: %s [PASSES]\n", argv[0]);
+      return -1;
+    }
+
+  for (pass = 0; pass < passes; pass++)
+    {
+      int64_t start = clock_gettime ();
+
+      for (i = 0; i < PAGE_CNT; i++)
+        *(int *) pages[i] = pass * PAGE_CNT + i;
+      for (i = 0; i < PAGE_CNT; i++)
+        if (*(int *) pages[i] != pass * PAGE_CNT + i)
+          bad++;
+
+      printf ("swapbench: pass %d over %d kB in %lld us\n",
+              pass, PAGE_CNT * PAGE_SIZE / 1024,
+              (clock_gettime () - start) / 1000);
+    }
+
+  if (bad > 0)
+    printf ("swapbench: %d pages read back wrong\n", bad);
+  return bad == 0 ? 0 : -1;
+}
@@ -4,7 +4,7 @@
 #include <list.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 
 /* A directory. */
@@ -27,12 +27,16 @@ struct dir_entry
 
 struct lock dir_lock;         /* Dir entry lock */
 
+/* Cache of `struct dir's. */
+static struct kmem_cache *dir_cache;
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 void
 dir_init(void)
 {
-  lock_init(&dir_lock);
+  lock_init_named(&dir_lock, "dir_lock");
+  dir_cache = kmem_cache_create ("dir", sizeof (struct dir), NULL);
 }
 
 
@@ -48,7 +52,7 @@ struct dir *
 dir_open (struct inode *inode) 
 {
   lock_acquire(&dir_lock);
-  struct dir *dir = calloc (1, sizeof *dir);
+  struct dir *dir = kmem_cache_alloc (dir_cache);
   if (inode != NULL && dir != NULL)
     {
       dir->inode = inode;
@@ -59,7 +63,7 @@ dir_open (struct inode *inode)
   else
     {
       inode_close (inode);
-      free (dir);
+      kmem_cache_free (dir_cache, dir);
       lock_release(&dir_lock);
       return NULL; 
     }
@@ -91,7 +95,7 @@ dir_close (struct dir *dir)
   if (dir != NULL)
     {
       inode_close (dir->inode);
-      free (dir);
+      kmem_cache_free (dir_cache, dir);
     }
 
   /* LOCK */
@@ -24,6 +24,7 @@ filesys_init (bool format)
     PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
   inode_init ();
+  file_init ();
   free_map_init ();
 
   if (format) 
@@ -22,7 +22,7 @@ free_map_init (void)
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
 
   /* INIT LOCK */
-  lock_init(&free_map_lock);
+  lock_init_named(&free_map_lock, "free_map_lock");
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
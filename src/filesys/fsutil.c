@@ -92,7 +92,7 @@ fsutil_put (char **argv)
   printf ("Putting '%s' into the file system...\n", file_name);
 
   /* Allocate buffer. */
-  buffer = malloc (DISK_SECTOR_SIZE);
+  buffer = malloc_tagged (DISK_SECTOR_SIZE, MALLOC_FILESYS);
   if (buffer == NULL)
     PANIC ("couldn't allocate buffer");
 
@@ -157,7 +157,7 @@ fsutil_get (char **argv)
   printf ("Getting '%s' from the file system...\n", file_name);
 
   /* Allocate buffer. */
-  buffer = malloc (DISK_SECTOR_SIZE);
+  buffer = malloc_tagged (DISK_SECTOR_SIZE, MALLOC_FILESYS);
   if (buffer == NULL)
     PANIC ("couldn't allocate buffer");
 
@@ -6,6 +6,7 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 
 
@@ -71,16 +72,40 @@ byte_to_sector (const struct inode *inode, off_t pos)
 static struct list open_inodes;
 struct lock list_lock;
 
+/* Cache of `struct inode's, kept with their locks and semaphore
+   initialized. */
+static struct kmem_cache *inode_cache;
+
+static void inode_ctor (void *);
+
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
-  lock_init(&list_lock);
+  lock_init_named(&list_lock, "list_lock");
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode), inode_ctor);
   //  lock_init(&rw_lock);
 }
 
+/* Initializes the locks and semaphore of an inode in
+   inode_cache, once for the life of the cache.  Readers and
+   writers leave them released again, so a freed inode is still
+   in this state. */
+static void
+inode_ctor (void *inode_) 
+{
+  struct inode *inode = inode_;
+
+  /* Init locks and semaphore used by the inode functions */ 
+  lock_init_named(&inode->inode_lock, "inode_lock"); 
+  lock_init_named(&inode->cnt_lock, "inode cnt_lock");
+  lock_init_named(&inode->w_lock, "inode w_lock");
+  sema_init(&inode->access, 1);
+  //  cond_init(&inode->wr_cond);
+}
+
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
    disk.
@@ -150,7 +175,7 @@ inode_open (disk_sector_t sector)
 
   // lock_release(&list_lock);  
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
   {
     lock_release(&list_lock);
@@ -166,13 +191,6 @@ inode_open (disk_sector_t sector)
   inode->open_cnt = 1;
   inode->readers = 0;
   inode->removed = false;
-
-  /* Init locks and semaphore used by the inode functions */ 
-  lock_init(&inode->inode_lock); 
-  lock_init(&inode->cnt_lock);
-  lock_init(&inode->w_lock);
-  sema_init(&inode->access, 1);
-  //  cond_init(&inode->wr_cond);
   
   disk_read (filesys_disk, inode->sector, &inode->data);
   
@@ -235,7 +253,7 @@ inode_close (struct inode *inode)
         }
 
       //lock_release(&inode->inode_lock);
-      free (inode);
+      kmem_cache_free (inode_cache, inode);
     }
   else
     lock_release(&inode->inode_lock);
@@ -301,7 +319,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
              into caller's buffer. */
           if (bounce == NULL) 
             {
-              bounce = malloc (DISK_SECTOR_SIZE);
+              bounce = malloc_tagged (DISK_SECTOR_SIZE, MALLOC_FILESYS);
               if (bounce == NULL)
                 break;
             }
@@ -393,7 +411,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
           /* We need a bounce buffer. */
           if (bounce == NULL) 
             {
-              bounce = malloc (DISK_SECTOR_SIZE);
+              bounce = malloc_tagged (DISK_SECTOR_SIZE, MALLOC_FILESYS);
               if (bounce == NULL)
                 break;
             }
@@ -63,7 +63,7 @@ static int64_t write_cnt;
 void
 console_init (void) 
 {
-  lock_init (&console_lock);
+  lock_init_named (&console_lock, "console_lock");
   use_console_lock = true;
 }
 
@@ -87,7 +87,7 @@ console_print_stats (void)
 static void
 acquire_console (void) 
 {
-  if (!intr_context () && use_console_lock) 
+  if (use_console_lock && !intr_context ()) 
     {
       if (lock_held_by_current_thread (&console_lock)) 
         console_lock_depth++; 
@@ -100,7 +100,7 @@ acquire_console (void)
 static void
 release_console (void) 
 {
-  if (!intr_context () && use_console_lock) 
+  if (use_console_lock && !intr_context ()) 
     {
       if (console_lock_depth > 0)
         console_lock_depth--;
@@ -114,8 +114,8 @@ release_console (void)
 static bool
 console_locked_by_current_thread (void) 
 {
-  return (intr_context ()
-          || !use_console_lock
+  return (!use_console_lock
+          || intr_context ()
           || lock_held_by_current_thread (&console_lock));
 }
 
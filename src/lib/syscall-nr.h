@@ -31,6 +31,11 @@ enum
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
     SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extended system calls. */
+    SYS_CLOCK_GETTIME,          /* Read the monotonic clock. */
+    SYS_FUTEX_WAIT,             /* Block on an int in a file. */
+    SYS_FUTEX_WAKE,             /* Wake processes blocked on one. */
     
     SYS_NUMBER_OF_CALLS
   };
@@ -194,3 +194,22 @@ inumber (int fd)
   return syscall1 (SYS_INUMBER, fd);
 }
 
+int64_t
+clock_gettime (void)
+{
+  int64_t ns;
+  syscall1 (SYS_CLOCK_GETTIME, &ns);
+  return ns;
+}
+
+int
+futex_wait (int fd, unsigned offset, int expected)
+{
+  return syscall3 (SYS_FUTEX_WAIT, fd, offset, expected);
+}
+
+int
+futex_wake (int fd, unsigned offset, int count)
+{
+  return syscall3 (SYS_FUTEX_WAKE, fd, offset, count);
+}
@@ -2,6 +2,7 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <debug.h>
 
 /* Process identifier. */
@@ -47,5 +48,10 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extended system calls. */
+int64_t clock_gettime (void);
+int futex_wait (int fd, unsigned offset, int expected);
+int futex_wake (int fd, unsigned offset, int count);
+
 
 #endif /* lib/user/syscall.h */
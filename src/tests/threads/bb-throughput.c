@@ -0,0 +1,153 @@
+/* Measures the throughput of a bounded buffer shared by several
+   producer and consumer threads, first moving one item per call
+   with bb_write() and bb_read(), then moving items in batches
+   with bb_write_n() and bb_read_n().  Checks that every item
+   written is read exactly once. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/boundedbuffer.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define PRODUCER_CNT 4          /* Number of producer threads. */
+#define CONSUMER_CNT 4          /* Number of consumer threads. */
+#define ITEM_CNT 8192           /* Items written by each producer. */
+#define BUFFER_SIZE 64          /* Buffer capacity, in items. */
+#define BATCH_SIZE 16           /* Items per call in batched runs. */
+
+/* Shared state of one run. */
+struct bb_test 
+  {
+    struct bounded_buffer bb;   /* The buffer under test. */
+    int batch;                  /* Items per call. */
+    struct lock sum_lock;       /* Protects SUM. */
+    int64_t sum;                /* Sum of all items read. */
+    struct semaphore done;      /* Upped by each finished thread. */
+  };
+
+/* Argument to a producer or consumer. */
+struct bb_worker 
+  {
+    struct bb_test *test;
+    int id;
+  };
+
+static void producer (void *);
+static void consumer (void *);
+static void run (int batch);
+
+void
+test_bb_throughput (void) 
+{
+  run (1);
+  run (BATCH_SIZE);
+  pass ();
+}
+
+/* Moves PRODUCER_CNT * ITEM_CNT items through a buffer, BATCH at
+   a time, and reports how long it took. */
+static void
+run (int batch) 
+{
+  struct bb_test test;
+  struct bb_worker workers[PRODUCER_CNT + CONSUMER_CNT];
+  int64_t start, elapsed, expected;
+  int total = PRODUCER_CNT * ITEM_CNT;
+  int i;
+
+  ASSERT (total % CONSUMER_CNT == 0);
+  ASSERT (ITEM_CNT % batch == 0);
+
+  bb_init (&test.bb, BUFFER_SIZE);
+  test.batch = batch;
+  lock_init (&test.sum_lock);
+  test.sum = 0;
+  sema_init (&test.done, 0);
+
+  start = timer_ns ();
+  for (i = 0; i < PRODUCER_CNT + CONSUMER_CNT; i++) 
+    {
+      char name[16];
+
+      workers[i].test = &test;
+      workers[i].id = i < PRODUCER_CNT ? i : i - PRODUCER_CNT;
+      snprintf (name, sizeof name, "%s %d",
+                i < PRODUCER_CNT ? "producer" : "consumer", workers[i].id);
+      thread_create (name, PRI_DEFAULT,
+                     i < PRODUCER_CNT ? producer : consumer, &workers[i]);
+    }
+  for (i = 0; i < PRODUCER_CNT + CONSUMER_CNT; i++)
+    sema_down (&test.done);
+  elapsed = timer_ns () - start;
+  bb_destroy (&test.bb);
+
+  /* Items are 0...TOTAL-1, so they add up to TOTAL*(TOTAL-1)/2. */
+  expected = (int64_t) total * (total - 1) / 2;
+  if (test.sum != expected)
+    fail ("batch %d: items add up to %"PRId64", expected %"PRId64,
+          batch, test.sum, expected);
+
+  msg ("batch %d: %d items in %"PRId64" us, %"PRId64" items/ms",
+       batch, total, elapsed / 1000,
+       elapsed > 0 ? (int64_t) total * 1000000 / elapsed : 0);
+}
+
+/* Writes this producer's ITEM_CNT items, BATCH at a time. */
+static void
+producer (void *worker_) 
+{
+  struct bb_worker *worker = worker_;
+  struct bb_test *test = worker->test;
+  int items[BATCH_SIZE];
+  int base = worker->id * ITEM_CNT;
+  int i, j;
+
+  for (i = 0; i < ITEM_CNT; i += test->batch) 
+    {
+      for (j = 0; j < test->batch; j++)
+        items[j] = base + i + j;
+      if (test->batch == 1)
+        bb_write (&test->bb, items[0]);
+      else
+        bb_write_n (&test->bb, items, test->batch);
+    }
+  sema_up (&test->done);
+}
+
+/* Reads this consumer's equal share of the items, up to BATCH at
+   a time, never asking for more than its share so that the other
+   consumers get theirs. */
+static void
+consumer (void *worker_) 
+{
+  struct bb_worker *worker = worker_;
+  struct bb_test *test = worker->test;
+  int items[BATCH_SIZE];
+  int left = PRODUCER_CNT * ITEM_CNT / CONSUMER_CNT;
+  int64_t sum = 0;
+  int i, cnt;
+
+  while (left > 0) 
+    {
+      if (test->batch == 1) 
+        {
+          items[0] = bb_read (&test->bb);
+          cnt = 1;
+        }
+      else
+        cnt = bb_read_n (&test->bb, items,
+                         left < test->batch ? left : test->batch);
+      for (i = 0; i < cnt; i++)
+        sum += items[i];
+      left -= cnt;
+    }
+
+  lock_acquire (&test->sum_lock);
+  test->sum += sum;
+  lock_release (&test->sum_lock);
+  sema_up (&test->done);
+}
@@ -0,0 +1,110 @@
+/* Times palloc_get_page() and palloc_free_page() on single
+   pages, then churns the page pool with random multi-page
+   allocations and frees.  Checks that afterward the free pages
+   have been merged back together, so that the largest run that
+   could be allocated at the start can be allocated again.  The
+   runs looked for go up to the size of all of memory, so the
+   check covers the pool's biggest free blocks, not just runs as
+   small as the ones the churn allocates. */
+
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "devices/timer.h"
+
+#define SINGLE_CNT 128          /* Pages held at once in single runs. */
+#define SINGLE_ROUNDS 64        /* Single-page rounds. */
+#define SLOT_CNT 32             /* Allocations held at once when mixed. */
+#define MAX_PAGES 8             /* Largest mixed allocation. */
+#define STEP_CNT 16384          /* Mixed allocations and frees. */
+
+static size_t largest_run (void);
+
+void
+test_palloc_bench (void) 
+{
+  static void *pages[SINGLE_CNT];
+  static struct { void *pages; size_t cnt; } slots[SLOT_CNT];
+  int64_t start, get_ns, free_ns;
+  size_t before, after;
+  int failures = 0;
+  int i, j;
+
+  before = largest_run ();
+  msg ("largest run before: %zu pages", before);
+
+  /* Single pages. */
+  get_ns = free_ns = 0;
+  for (i = 0; i < SINGLE_ROUNDS; i++) 
+    {
+      start = timer_ns ();
+      for (j = 0; j < SINGLE_CNT; j++)
+        pages[j] = palloc_get_page (PAL_ASSERT);
+      get_ns += timer_ns () - start;
+
+      start = timer_ns ();
+      for (j = 0; j < SINGLE_CNT; j++)
+        palloc_free_page (pages[j]);
+      free_ns += timer_ns () - start;
+    }
+  msg ("single pages: %"PRId64" ns per get, %"PRId64" ns per free",
+       get_ns / (SINGLE_ROUNDS * SINGLE_CNT),
+       free_ns / (SINGLE_ROUNDS * SINGLE_CNT));
+
+  /* Random runs of 1...MAX_PAGES pages, freed in random order. */
+  random_init (0);
+  start = timer_ns ();
+  for (i = 0; i < STEP_CNT; i++) 
+    {
+      int slot = random_ulong () % SLOT_CNT;
+
+      if (slots[slot].pages != NULL) 
+        {
+          palloc_free_multiple (slots[slot].pages, slots[slot].cnt);
+          slots[slot].pages = NULL;
+        }
+      else 
+        {
+          slots[slot].cnt = random_ulong () % MAX_PAGES + 1;
+          slots[slot].pages = palloc_get_multiple (0, slots[slot].cnt);
+          if (slots[slot].pages == NULL)
+            failures++;
+        }
+    }
+  for (i = 0; i < SLOT_CNT; i++)
+    if (slots[i].pages != NULL)
+      palloc_free_multiple (slots[i].pages, slots[i].cnt);
+  msg ("mixed runs: %d steps in %"PRId64" us, %d failed",
+       STEP_CNT, (timer_ns () - start) / 1000, failures);
+
+  palloc_print_stats ();
+  after = largest_run ();
+  msg ("largest run after: %zu pages", after);
+  if (after < before)
+    fail ("free pages were not merged back together");
+  pass ();
+}
+
+/* Returns the largest power-of-two number of pages that can be
+   allocated from the page pool in one piece. */
+static size_t
+largest_run (void) 
+{
+  size_t cnt;
+
+  for (cnt = 1; cnt * 2 <= ram_pages; cnt *= 2)
+    continue;
+  for (; cnt > 1; cnt /= 2) 
+    {
+      void *pages = palloc_get_multiple (0, cnt);
+      if (pages != NULL) 
+        {
+          palloc_free_multiple (pages, cnt);
+          break;
+        }
+    }
+  return cnt;
+}
@@ -0,0 +1,184 @@
+/* Checks sl_try_remove(), sl_append_batch() and
+   sl_remove_batch(): that a batch goes on and comes off a list
+   in order, that sl_remove_batch() takes no more than asked for,
+   and that appending a batch wakes up as many blocked removers
+   as it can satisfy. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/synchlist.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define ITEM_CNT 16             /* Items in the in-order checks. */
+#define CONSUMER_CNT 4          /* Threads blocked in sl_remove_batch(). */
+#define CONSUMER_BATCH 3        /* Items each of them asks for. */
+
+/* An item on the list. */
+struct item
+  {
+    struct list_elem elem;
+    int value;
+  };
+
+static struct SynchList sl;
+static struct item items[ITEM_CNT];
+static size_t received[CONSUMER_CNT];   /* Items each consumer got. */
+static int sums[CONSUMER_CNT];          /* Sum of the values it got. */
+static struct semaphore done;
+
+static thread_func consumer;
+static void fill (struct list *, int cnt);
+static void check_order (struct list *, int first, int cnt);
+
+void
+test_synchlist_batch (void)
+{
+  struct list batch, got;
+  struct list_elem *e;
+  size_t cnt;
+  int i, sum;
+
+  sl_init (&sl);
+  list_init (&batch);
+  list_init (&got);
+
+  /* sl_try_remove() does not wait. */
+  if (sl_try_remove (&sl) != NULL)
+    fail ("sl_try_remove on empty list returned an element");
+  msg ("sl_try_remove on empty list: empty");
+
+  /* A batch comes off in the order it went on, one at a time. */
+  fill (&batch, ITEM_CNT);
+  sl_append_batch (&sl, &batch);
+  if (!list_empty (&batch))
+    fail ("sl_append_batch left elements in the batch");
+  for (i = 0; i < ITEM_CNT; i++)
+    {
+      e = sl_try_remove (&sl);
+      if (e == NULL)
+        fail ("sl_try_remove returned no element %d of %d", i, ITEM_CNT);
+      if (list_entry (e, struct item, elem)->value != i)
+        fail ("sl_try_remove returned %d, expected %d",
+              list_entry (e, struct item, elem)->value, i);
+    }
+  if (sl_try_remove (&sl) != NULL)
+    fail ("sl_try_remove returned more than was appended");
+  msg ("sl_append_batch of %d, sl_try_remove: in order", ITEM_CNT);
+
+  /* sl_remove_batch() takes at most MAX, from the front. */
+  fill (&batch, ITEM_CNT);
+  sl_append_batch (&sl, &batch);
+  cnt = sl_remove_batch (&sl, &got, ITEM_CNT / 4);
+  if (cnt != ITEM_CNT / 4)
+    fail ("sl_remove_batch returned %zu, expected %d", cnt, ITEM_CNT / 4);
+  check_order (&got, 0, ITEM_CNT / 4);
+  cnt = sl_remove_batch (&sl, &got, ITEM_CNT);
+  if (cnt != ITEM_CNT - ITEM_CNT / 4)
+    fail ("sl_remove_batch returned %zu, expected %d",
+          cnt, ITEM_CNT - ITEM_CNT / 4);
+  check_order (&got, ITEM_CNT / 4, ITEM_CNT - ITEM_CNT / 4);
+  if (sl_try_remove (&sl) != NULL)
+    fail ("sl_remove_batch left elements on the list");
+  msg ("sl_remove_batch of %d then %d: in order",
+       ITEM_CNT / 4, ITEM_CNT - ITEM_CNT / 4);
+
+  /* One batch wakes up every blocked remover it has items for.
+     Each consumer asks for CONSUMER_BATCH items and there are
+     exactly enough for all of them, so each one gets its full
+     share, and a consumer left blocked hangs the test. */
+  sema_init (&done, 0);
+  for (i = 0; i < CONSUMER_CNT; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "consumer %d", i);
+      thread_create (name, PRI_DEFAULT, consumer, (void *) i);
+    }
+  timer_sleep (10);
+  fill (&batch, CONSUMER_CNT * CONSUMER_BATCH);
+  sl_append_batch (&sl, &batch);
+  for (i = 0; i < CONSUMER_CNT; i++)
+    sema_down (&done);
+  sum = 0;
+  for (i = 0; i < CONSUMER_CNT; i++)
+    {
+      if (received[i] != CONSUMER_BATCH)
+        fail ("consumer %d got %zu items, expected %d",
+              i, received[i], CONSUMER_BATCH);
+      sum += sums[i];
+    }
+  /* Values are 0...N-1, so they add up to N*(N-1)/2. */
+  if (sum != CONSUMER_CNT * CONSUMER_BATCH
+             * (CONSUMER_CNT * CONSUMER_BATCH - 1) / 2)
+    fail ("consumers' items add up to %d", sum);
+  msg ("sl_append_batch to %d blocked sl_remove_batch: %d items each",
+       CONSUMER_CNT, CONSUMER_BATCH);
+
+  /* A batch of one wakes up a single remover. */
+  sema_init (&done, 0);
+  thread_create ("consumer 0", PRI_DEFAULT, consumer, (void *) 0);
+  timer_sleep (10);
+  fill (&batch, 1);
+  sl_append_batch (&sl, &batch);
+  sema_down (&done);
+  if (received[0] != 1)
+    fail ("consumer got %zu items, expected 1", received[0]);
+  msg ("sl_append_batch of 1 to blocked sl_remove_batch: 1 item");
+
+  sl_destroy (&sl);
+}
+
+/* Takes up to CONSUMER_BATCH items off the list, waiting for
+   them, and records how many it got in slot AUX. */
+static void
+consumer (void *aux)
+{
+  int id = (int) aux;
+  struct list got;
+  struct list_elem *e;
+
+  list_init (&got);
+  received[id] = sl_remove_batch (&sl, &got, CONSUMER_BATCH);
+  sums[id] = 0;
+  for (e = list_begin (&got); e != list_end (&got); e = list_next (e))
+    sums[id] += list_entry (e, struct item, elem)->value;
+  sema_up (&done);
+}
+
+/* Puts the first CNT of `items' on LIST, numbered 0...CNT-1. */
+static void
+fill (struct list *list, int cnt)
+{
+  int i;
+
+  ASSERT (cnt <= (int) (sizeof items / sizeof *items));
+  list_init (list);
+  for (i = 0; i < cnt; i++)
+    {
+      items[i].value = i;
+      list_push_back (list, &items[i].elem);
+    }
+}
+
+/* Checks that LIST holds exactly the CNT items numbered FIRST
+   onward, in order, and empties it. */
+static void
+check_order (struct list *list, int first, int cnt)
+{
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct item *it;
+
+      if (list_empty (list))
+        fail ("batch ended after %d of %d items", i, cnt);
+      it = list_entry (list_pop_front (list), struct item, elem);
+      if (it->value != first + i)
+        fail ("got item %d, expected %d", it->value, first + i);
+    }
+  if (!list_empty (list))
+    fail ("batch had more than %d items", cnt);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(synchlist-batch) begin
+(synchlist-batch) sl_try_remove on empty list: empty
+(synchlist-batch) sl_append_batch of 16, sl_try_remove: in order
+(synchlist-batch) sl_remove_batch of 4 then 12: in order
+(synchlist-batch) sl_append_batch to 4 blocked sl_remove_batch: 3 items each
+(synchlist-batch) sl_append_batch of 1 to blocked sl_remove_batch: 1 item
+(synchlist-batch) end
+EOF
+pass;
@@ -39,7 +39,11 @@ static const struct test tests[] =
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
     {"threadtest", ThreadTest},
-    {"simplethreadtest", SimpleThreadTest}
+    {"simplethreadtest", SimpleThreadTest},
+    {"bb-throughput", test_bb_throughput},
+    {"timed-wait", test_timed_wait},
+    {"palloc-bench", test_palloc_bench},
+    {"synchlist-batch", test_synchlist_batch}
   };
 
 static const char *test_name;
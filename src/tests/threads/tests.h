@@ -34,6 +34,10 @@ extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
 extern test_func ThreadTest;
 extern test_func SimpleThreadTest;
+extern test_func test_bb_throughput;
+extern test_func test_timed_wait;
+extern test_func test_palloc_bench;
+extern test_func test_synchlist_batch;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
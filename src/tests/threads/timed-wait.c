@@ -0,0 +1,213 @@
+/* Checks that sema_down_timeout(), lock_acquire_timeout(),
+   cond_wait_timeout() and sl_remove_timeout() give up once
+   their time is up, but not before, and that they succeed when
+   woken up in time.  Also checks that a waiter that times out
+   leaves the semaphore's wait list intact, both while other
+   threads are ready to run and while other waiters on the same
+   semaphore are woken up in its place. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/synchlist.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* How long a waiter gives up after, and how long the helper
+   thread takes to wake it up, in timer ticks. */
+#define SHORT 5
+#define LONG 50
+
+#define SPINNER_CNT 3           /* Threads kept ready meanwhile. */
+#define WAITER_CNT 4            /* Timed waiters on one semaphore. */
+
+static struct semaphore sema;
+static struct lock lock;
+static struct condition cond;
+static struct semaphore helper_done;
+static volatile bool spinners_stop;
+static bool waiter_ok[WAITER_CNT];
+
+static thread_func up_helper, hold_helper, signal_helper;
+static thread_func spinner, waiter;
+static void check_elapsed (const char *what, int64_t start, bool timed_out);
+
+void
+test_timed_wait (void) 
+{
+  struct SynchList sl;
+  int64_t start;
+  bool ok;
+  int i;
+
+  sema_init (&sema, 0);
+  lock_init (&lock);
+  cond_init (&cond);
+  sema_init (&helper_done, 0);
+
+  /* Semaphores. */
+  start = timer_ticks ();
+  ok = sema_down_timeout (&sema, SHORT);
+  msg ("sema_down_timeout with no sema_up: %s", ok ? "succeeded" : "timed out");
+  check_elapsed ("sema_down_timeout", start, !ok);
+  if (!list_empty (&sema.waiters))
+    fail ("timed-out waiter left on the wait list");
+
+  thread_create ("up", PRI_DEFAULT, up_helper, NULL);
+  start = timer_ticks ();
+  ok = sema_down_timeout (&sema, LONG);
+  msg ("sema_down_timeout with sema_up: %s", ok ? "succeeded" : "timed out");
+  check_elapsed ("sema_down_timeout", start, !ok);
+  sema_down (&helper_done);
+
+  /* A timeout while other threads are ready to run.  The timer
+     puts the waiter on the ready list behind them. */
+  spinners_stop = false;
+  for (i = 0; i < SPINNER_CNT; i++)
+    thread_create ("spinner", PRI_DEFAULT, spinner, NULL);
+  start = timer_ticks ();
+  ok = sema_down_timeout (&sema, SHORT);
+  msg ("sema_down_timeout with %d threads ready: %s",
+       SPINNER_CNT, ok ? "succeeded" : "timed out");
+  check_elapsed ("sema_down_timeout", start, !ok);
+  if (!list_empty (&sema.waiters))
+    fail ("timed-out waiter left on the wait list");
+  spinners_stop = true;
+  for (i = 0; i < SPINNER_CNT; i++)
+    sema_down (&helper_done);
+
+  /* Several timed waiters on one semaphore.  The first half give
+     up after SHORT ticks, while they are still at the front of
+     the wait list, and the second half are woken by sema_up()
+     after that, which must pass over the ones that timed out. */
+  for (i = 0; i < WAITER_CNT; i++)
+    {
+      thread_create ("waiter", PRI_DEFAULT, waiter, (void *) i);
+      timer_sleep (1);
+    }
+  timer_sleep (SHORT * 2);
+  for (i = WAITER_CNT / 2; i < WAITER_CNT; i++)
+    sema_up (&sema);
+  for (i = 0; i < WAITER_CNT; i++)
+    sema_down (&helper_done);
+  for (i = 0; i < WAITER_CNT; i++)
+    if (waiter_ok[i] != (i >= WAITER_CNT / 2))
+      fail ("waiter %d %s", i, waiter_ok[i] ? "succeeded" : "timed out");
+  if (!list_empty (&sema.waiters))
+    fail ("waiters left on the wait list");
+  if (sema.value != 0)
+    fail ("semaphore value is %u, expected 0", sema.value);
+  msg ("%d timed waiters: %d timed out, %d woken by sema_up",
+       WAITER_CNT, WAITER_CNT / 2, WAITER_CNT - WAITER_CNT / 2);
+
+  /* Locks. */
+  thread_create ("hold", PRI_DEFAULT, hold_helper, NULL);
+  sema_down (&sema);
+  start = timer_ticks ();
+  ok = lock_acquire_timeout (&lock, SHORT);
+  msg ("lock_acquire_timeout on held lock: %s",
+       ok ? "succeeded" : "timed out");
+  check_elapsed ("lock_acquire_timeout", start, !ok);
+  start = timer_ticks ();
+  ok = lock_acquire_timeout (&lock, LONG);
+  msg ("lock_acquire_timeout on released lock: %s",
+       ok ? "succeeded" : "timed out");
+  check_elapsed ("lock_acquire_timeout", start, !ok);
+  lock_release (&lock);
+  sema_down (&helper_done);
+
+  /* Condition variables. */
+  lock_acquire (&lock);
+  start = timer_ticks ();
+  ok = cond_wait_timeout (&cond, &lock, SHORT);
+  msg ("cond_wait_timeout with no signal: %s", ok ? "succeeded" : "timed out");
+  check_elapsed ("cond_wait_timeout", start, !ok);
+  if (!lock_held_by_current_thread (&lock))
+    fail ("cond_wait_timeout returned without the lock");
+
+  thread_create ("signal", PRI_DEFAULT, signal_helper, NULL);
+  start = timer_ticks ();
+  ok = cond_wait_timeout (&cond, &lock, LONG);
+  msg ("cond_wait_timeout with signal: %s", ok ? "succeeded" : "timed out");
+  check_elapsed ("cond_wait_timeout", start, !ok);
+  lock_release (&lock);
+  sema_down (&helper_done);
+
+  /* Synchronized lists. */
+  sl_init (&sl);
+  start = timer_ticks ();
+  msg ("sl_remove_timeout on empty list: %s",
+       sl_remove_timeout (&sl, SHORT) == NULL ? "timed out" : "succeeded");
+  check_elapsed ("sl_remove_timeout", start, true);
+  sl_destroy (&sl);
+}
+
+/* Fails if a wait that started at START and timed out, if
+   TIMED_OUT, or succeeded, otherwise, took an unreasonable
+   amount of time. */
+static void
+check_elapsed (const char *what, int64_t start, bool timed_out) 
+{
+  int64_t elapsed = timer_elapsed (start);
+
+  if (timed_out && elapsed < SHORT)
+    fail ("%s timed out after %"PRId64" ticks, before %d",
+          what, elapsed, SHORT);
+  if (!timed_out && elapsed >= LONG)
+    fail ("%s took %"PRId64" ticks, past its %d-tick timeout",
+          what, elapsed, LONG);
+}
+
+/* Ups SEMA after SHORT ticks. */
+static void
+up_helper (void *aux UNUSED) 
+{
+  timer_sleep (SHORT);
+  sema_up (&sema);
+  sema_up (&helper_done);
+}
+
+/* Yields until told to stop, staying ready to run. */
+static void
+spinner (void *aux UNUSED) 
+{
+  while (!spinners_stop)
+    thread_yield ();
+  sema_up (&helper_done);
+}
+
+/* Waits for SEMA with a timeout: SHORT ticks for the first half
+   of the waiters, by number AUX, and LONG ticks for the rest. */
+static void
+waiter (void *aux) 
+{
+  int id = (int) aux;
+
+  waiter_ok[id] = sema_down_timeout (&sema,
+                                     id < WAITER_CNT / 2 ? SHORT : LONG);
+  sema_up (&helper_done);
+}
+
+/* Holds LOCK for a while: longer than the first attempt to get
+   it waits, but well within the second one. */
+static void
+hold_helper (void *aux UNUSED) 
+{
+  lock_acquire (&lock);
+  sema_up (&sema);
+  timer_sleep (SHORT * 2);
+  lock_release (&lock);
+  sema_up (&helper_done);
+}
+
+/* Signals COND after SHORT ticks. */
+static void
+signal_helper (void *aux UNUSED) 
+{
+  timer_sleep (SHORT);
+  lock_acquire (&lock);
+  cond_signal (&cond, &lock);
+  lock_release (&lock);
+  sema_up (&helper_done);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(timed-wait) begin
+(timed-wait) sema_down_timeout with no sema_up: timed out
+(timed-wait) sema_down_timeout with sema_up: succeeded
+(timed-wait) sema_down_timeout with 3 threads ready: timed out
+(timed-wait) 4 timed waiters: 2 timed out, 2 woken by sema_up
+(timed-wait) lock_acquire_timeout on held lock: timed out
+(timed-wait) lock_acquire_timeout on released lock: succeeded
+(timed-wait) cond_wait_timeout with no signal: timed out
+(timed-wait) cond_wait_timeout with signal: succeeded
+(timed-wait) sl_remove_timeout on empty list: timed out
+(timed-wait) end
+EOF
+pass;
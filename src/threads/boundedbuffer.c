@@ -10,27 +10,170 @@
 // Modified by Vlad Jahundovics (translation from C++ to C)
 
 #include "threads/boundedbuffer.h"
+#include <debug.h>
+#include <string.h>
 #include "threads/malloc.h"
 
+static void copy_in(struct bounded_buffer *, const int *, int);
+static void copy_out(struct bounded_buffer *, int *, int);
+
+//----------------------------------------------------------------------
+// bb_init
+//	Initialize BB as an empty buffer with room for _SIZE items.
+//----------------------------------------------------------------------
+
 void bb_init(struct bounded_buffer *bb, int _size)
 {
+  ASSERT(_size > 0);
+
   bb->size = _size;
-  // write your code here
+  bb->items = malloc(_size * sizeof *bb->items);
+  if (bb->items == NULL)
+    PANIC("bb_init: out of memory");
+  bb->head = bb->tail = bb->count = 0;
+  lock_init(&bb->lock);
+  cond_init(&bb->not_full);
+  cond_init(&bb->not_empty);
 }
 
-void bb_destroy(struct bounded_buffer *bb UNUSED)
+//----------------------------------------------------------------------
+// bb_destroy
+//	Free the ring.  No thread may be using BB any more.
+//----------------------------------------------------------------------
+
+void bb_destroy(struct bounded_buffer *bb)
+{
+  free(bb->items);
+  bb->items = NULL;
+}
+
+//----------------------------------------------------------------------
+// bb_read
+//	Remove and return the oldest item, waiting while BB is empty.
+//----------------------------------------------------------------------
+
+int bb_read(struct bounded_buffer *bb)
+{
+  int value;
+
+  bb_read_n(bb, &value, 1);
+  return value;
+}
+
+//----------------------------------------------------------------------
+// bb_write
+//	Append VALUE, waiting while BB is full.
+//----------------------------------------------------------------------
+
+void bb_write(struct bounded_buffer *bb, int value)
+{
+  bb_write_n(bb, &value, 1);
+}
+
+//----------------------------------------------------------------------
+// bb_read_n
+//	Remove up to N of the oldest items into ITEMS, in order, waiting
+//	only while BB is empty.  Takes everything that is there, up to N,
+//	in one lock acquisition.
+// Returns:
+//	The number of items read, between 1 and N.
+//----------------------------------------------------------------------
+
+int bb_read_n(struct bounded_buffer *bb, int *items, int n)
 {
-  // write your code here
+  int cnt;
+
+  ASSERT(n > 0);
+
+  lock_acquire(&bb->lock);
+  while (bb->count == 0)
+    cond_wait(&bb->not_empty, &bb->lock);
+
+  cnt = bb->count < n ? bb->count : n;
+  copy_out(bb, items, cnt);
+
+  // One freed slot is enough for one writer; more may let several go.
+  if (cnt == 1)
+    cond_signal(&bb->not_full, &bb->lock);
+  else
+    cond_broadcast(&bb->not_full, &bb->lock);
+  lock_release(&bb->lock);
+  return cnt;
 }
 
-int bb_read(struct bounded_buffer *bb UNUSED)
+//----------------------------------------------------------------------
+// bb_write_n
+//	Append the N items in ITEMS, in order.  Each time BB has room,
+//	as many items as fit are copied in at once, so a writer that
+//	keeps ahead of the readers only waits once per buffer's worth.
+//	Items from concurrent writers may be interleaved between those
+//	batches.
+//----------------------------------------------------------------------
+
+void bb_write_n(struct bounded_buffer *bb, const int *items, int n)
 {
-  // write your code here
-  return 0;
+  ASSERT(n >= 0);
+
+  lock_acquire(&bb->lock);
+  while (n > 0) {
+    int room, cnt;
+
+    while (bb->count == bb->size)
+      cond_wait(&bb->not_full, &bb->lock);
+
+    room = bb->size - bb->count;
+    cnt = room < n ? room : n;
+    copy_in(bb, items, cnt);
+    items += cnt;
+    n -= cnt;
+
+    if (cnt == 1)
+      cond_signal(&bb->not_empty, &bb->lock);
+    else
+      cond_broadcast(&bb->not_empty, &bb->lock);
+  }
+  lock_release(&bb->lock);
 }
 
-void bb_write(struct bounded_buffer *bb UNUSED, int value UNUSED)
+//----------------------------------------------------------------------
+// copy_in
+//	Copy CNT items from ITEMS to the head of the ring, which must
+//	have room for them.  At most two memcpy() calls, one on each side
+//	of the wraparound.
+//----------------------------------------------------------------------
+
+static void copy_in(struct bounded_buffer *bb, const int *items, int cnt)
 {
-  // write your code here
+  int first = bb->size - bb->head;
+
+  ASSERT(lock_held_by_current_thread(&bb->lock));
+  ASSERT(cnt <= bb->size - bb->count);
+
+  if (first > cnt)
+    first = cnt;
+  memcpy(bb->items + bb->head, items, first * sizeof *items);
+  memcpy(bb->items, items + first, (cnt - first) * sizeof *items);
+  bb->head = (bb->head + cnt) % bb->size;
+  bb->count += cnt;
 }
 
+//----------------------------------------------------------------------
+// copy_out
+//	Copy CNT items from the tail of the ring, which must hold at
+//	least that many, to ITEMS.
+//----------------------------------------------------------------------
+
+static void copy_out(struct bounded_buffer *bb, int *items, int cnt)
+{
+  int first = bb->size - bb->tail;
+
+  ASSERT(lock_held_by_current_thread(&bb->lock));
+  ASSERT(cnt <= bb->count);
+
+  if (first > cnt)
+    first = cnt;
+  memcpy(items, bb->items + bb->tail, first * sizeof *items);
+  memcpy(items + first, bb->items, (cnt - first) * sizeof *items);
+  bb->tail = (bb->tail + cnt) % bb->size;
+  bb->count -= cnt;
+}
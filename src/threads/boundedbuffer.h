@@ -10,15 +10,25 @@
 
 #include "threads/synch.h"
 
+// A fixed-size ring of ints, shared by any number of writer and
+// reader threads.  Writers wait while it is full, readers while it
+// is empty.
 struct bounded_buffer {
   int size;
-  // You may add other data fields required for the bounded buffer
-
+  int *items;                   // ring of SIZE slots
+  int head;                     // next slot to write
+  int tail;                     // next slot to read
+  int count;                    // number of items in the ring
+  struct lock lock;             // protects all of the above
+  struct condition not_full;    // signalled when slots are freed
+  struct condition not_empty;   // signalled when items are added
 };
 
 void bb_init(struct bounded_buffer *, int);
 int bb_read(struct bounded_buffer *);
 void bb_write(struct bounded_buffer *, int);
+int bb_read_n(struct bounded_buffer *, int *, int);
+void bb_write_n(struct bounded_buffer *, const int *, int);
 void bb_destroy(struct bounded_buffer *);
 
 #endif
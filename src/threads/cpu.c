@@ -0,0 +1,313 @@
+#include "threads/cpu.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/loader.h"
+#include "threads/pte.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#endif
+
+/* Symmetric multiprocessing.
+
+   At boot, cpu_init() looks for the CPUs listed in the MP
+   configuration table that the BIOS leaves in low memory (see
+   [MP-Spec] chapter 4).  The bootstrap processor, which is
+   running this code, becomes cpus[0].  Once the timer works,
+   cpu_start_aps() wakes up the other, "application" processors
+   one at a time with the INIT/start-up IPI sequence of [MP-Spec]
+   appendix B.4.  Each one enters the kernel through
+   threads/ap-start.S and cpu_ap_main() and then runs its own
+   idle thread and scheduler with its own run queue.
+
+   Device interrupts stay with the bootstrap processor; the
+   other processors take their timer tick from their local APIC
+   timer (see devices/lapic.c). */
+
+/* All CPUs found at boot, the bootstrap processor first. */
+struct cpu cpus[CPU_MAX];
+unsigned cpu_cnt;
+
+/* Physical address of the local APICs' registers. */
+static uint32_t lapic_addr;
+
+/* MP floating pointer structure.  See [MP-Spec] 4.1. */
+struct mp_fp
+  {
+    char signature[4];          /* "_MP_". */
+    uint32_t config;            /* Physical address of config table. */
+    uint8_t length;             /* In 16-byte units. */
+    uint8_t spec_rev;           /* MP spec revision. */
+    uint8_t checksum;           /* All bytes must sum to 0. */
+    uint8_t features[5];        /* Nonzero FEATURES[0]: default config. */
+  };
+
+/* MP configuration table header.  See [MP-Spec] 4.2. */
+struct mp_config
+  {
+    char signature[4];          /* "PCMP". */
+    uint16_t length;            /* Length of base table, in bytes. */
+    uint8_t spec_rev;           /* MP spec revision. */
+    uint8_t checksum;           /* All bytes must sum to 0. */
+    char oem_id[8];
+    char product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_cnt;         /* Number of entries that follow. */
+    uint32_t lapic_addr;        /* Physical address of local APICs. */
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+  };
+
+/* MP configuration table processor entry.  See [MP-Spec]
+   4.3.1.  Every other kind of entry is 8 bytes long. */
+#define MP_PROCESSOR 0
+struct mp_processor
+  {
+    uint8_t type;               /* MP_PROCESSOR. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    uint8_t apic_version;
+    uint8_t flags;              /* See below. */
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+  };
+#define MP_PROC_ENABLED 0x01    /* Processor usable. */
+#define MP_PROC_BSP 0x02        /* Bootstrap processor. */
+
+static void mp_detect (void);
+static struct mp_fp *mp_search (uintptr_t phys, size_t size);
+static bool checksum_ok (const void *, size_t size);
+static intr_handler_func resched_interrupt;
+void cpu_ap_main (void) NO_RETURN;
+
+/* Sets up per-CPU data for the bootstrap processor and finds
+   out what other CPUs there are, without starting them.  Called
+   by thread_init(), so it may not print or allocate memory. */
+void
+cpu_init (void)
+{
+  unsigned i;
+
+  for (i = 0; i < CPU_MAX; i++)
+    {
+      struct cpu *c = &cpus[i];
+      memset (c, 0, sizeof *c);
+      c->id = i;
+      spinlock_init (&c->rq_lock);
+      list_init (&c->ready_list);
+    }
+  cpu_cnt = 1;
+  cpus[0].online = true;
+
+  mp_detect ();
+}
+
+/* Returns the CPU that is running this code.  Like
+   running_thread() in thread.c, finds the running thread from
+   the stack pointer; schedule() keeps its `cpu' member up to
+   date.  Interrupts should be off, or the caller could move to
+   another CPU before it uses the result. */
+struct cpu *
+cpu_current (void)
+{
+  uint32_t *esp;
+  struct thread *t;
+
+  asm ("mov %%esp, %0" : "=g" (esp));
+  t = pg_round_down (esp);
+  return t->cpu;
+}
+
+/* Makes CPU C look at its run queue soon, by interrupting it if
+   it is another CPU.  Interrupts must be off. */
+void
+cpu_kick (struct cpu *c)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (c != cpu_current () && c->online)
+    lapic_send_ipi (c->apic_id, LAPIC_RESCHED_VEC);
+}
+
+/* Starts every application processor found by cpu_init(), one
+   at a time, and waits for each to come online.  A processor
+   that does not respond is left offline. */
+void
+cpu_start_aps (void)
+{
+  extern uint8_t ap_start[], ap_start_end[], ap_cr3[], ap_stack[];
+  uint8_t *code = ptov (LOADER_AP_START);
+  unsigned online = 1;
+  unsigned i;
+
+  ASSERT (intr_get_level () == INTR_ON);
+  ASSERT ((size_t) (ap_start_end - ap_start) <= PGSIZE);
+
+  if (cpu_cnt == 1)
+    return;
+
+  lapic_init (lapic_addr);
+  lapic_timer_calibrate ();
+  intr_register_ext (LAPIC_RESCHED_VEC, resched_interrupt, "Reschedule IPI");
+
+  /* Install the start-up code and map the bottom 4 MB of
+     physical memory at virtual address 0 as well, which it
+     needs while it turns on paging. */
+  memcpy (code, ap_start, ap_start_end - ap_start);
+  *(uint32_t *) (code + (ap_cr3 - ap_start)) = vtop (base_page_dir);
+  base_page_dir[0] = base_page_dir[pd_no (ptov (0))];
+
+  /* Point the BIOS warm reset vector at the start-up code too.
+     See [MP-Spec] B.4. */
+  outb (0x70, 0x0f);
+  outb (0x71, 0x0a);
+  *(uint16_t *) ptov (0x467) = 0;
+  *(uint16_t *) ptov (0x469) = LOADER_AP_START >> 4;
+
+  for (i = 1; i < cpu_cnt; i++)
+    {
+      struct cpu *c = &cpus[i];
+      struct thread *idle = thread_create_idle (c);
+      int wait;
+
+      if (idle == NULL)
+        break;
+      *(uint32_t *) (code + (ap_stack - ap_start)) = (uint32_t) idle + PGSIZE;
+
+      lapic_send_init (c->apic_id);
+      timer_msleep (10);
+      lapic_send_startup (c->apic_id, LOADER_AP_START);
+      timer_usleep (200);
+      lapic_send_startup (c->apic_id, LOADER_AP_START);
+
+      for (wait = 0; !c->online && wait < 100; wait++)
+        timer_msleep (1);
+      if (c->online)
+        online++;
+      else
+        printf ("cpu%u: local APIC %u did not start.\n", i, c->apic_id);
+    }
+
+  /* Remove the low mapping again. */
+  base_page_dir[0] = 0;
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (base_page_dir)) : "memory");
+
+  printf ("%u of %u CPUs online.\n", online, cpu_cnt);
+}
+
+/* Entered by each application processor from ap-start.S, running
+   on the page of the idle thread that cpu_start_aps() created for
+   it.  Finishes setting up the processor and starts
+   scheduling. */
+void
+cpu_ap_main (void)
+{
+  intr_init_ap ();
+#ifdef USERPROG
+  gdt_init_ap ();
+#endif
+  lapic_init_ap ();
+  ASSERT (lapic_id () == cpu_current ()->apic_id);
+  lapic_timer_start ();
+
+  thread_start_ap ();
+}
+
+/* Fills in cpus[] from the MP configuration table, if the BIOS
+   provides one.  Without it, or if the table only describes a
+   default configuration, we stay on a single CPU. */
+static void
+mp_detect (void)
+{
+  struct mp_fp *fp = NULL;
+  struct mp_config *config;
+  uint8_t *entry, *end;
+  uint16_t ebda;
+  uint16_t base_kb;
+
+  /* Search the first kB of the extended BIOS data area, the
+     last kB of base memory, and the BIOS ROM, in that order.
+     See [MP-Spec] 4. */
+  ebda = *(uint16_t *) ptov (0x40e);
+  base_kb = *(uint16_t *) ptov (0x413);
+  if (ebda != 0)
+    fp = mp_search ((uintptr_t) ebda << 4, 1024);
+  if (fp == NULL && base_kb != 0)
+    fp = mp_search (base_kb * 1024 - 1024, 1024);
+  if (fp == NULL)
+    fp = mp_search (0xf0000, 0x10000);
+  if (fp == NULL || fp->config == 0 || fp->features[0] != 0
+      || fp->config >= ram_pages * PGSIZE)
+    return;
+
+  config = ptov (fp->config);
+  if (memcmp (config->signature, "PCMP", 4)
+      || !checksum_ok (config, config->length))
+    return;
+  lapic_addr = config->lapic_addr;
+
+  entry = (uint8_t *) (config + 1);
+  end = (uint8_t *) config + config->length;
+  while (entry < end)
+    {
+      struct mp_processor *p = (struct mp_processor *) entry;
+
+      if (p->type != MP_PROCESSOR)
+        {
+          entry += 8;
+          continue;
+        }
+      entry += sizeof *p;
+
+      if (!(p->flags & MP_PROC_ENABLED))
+        continue;
+      if (p->flags & MP_PROC_BSP)
+        cpus[0].apic_id = p->apic_id;
+      else if (cpu_cnt < CPU_MAX)
+        cpus[cpu_cnt++].apic_id = p->apic_id;
+    }
+}
+
+/* Looks for the MP floating pointer structure in the SIZE bytes
+   of physical memory starting at PHYS.  Returns it if found,
+   otherwise a null pointer. */
+static struct mp_fp *
+mp_search (uintptr_t phys, size_t size)
+{
+  uint8_t *p = ptov (phys);
+  uint8_t *end = p + size;
+
+  for (; p + sizeof (struct mp_fp) <= end; p += 16)
+    if (!memcmp (p, "_MP_", 4) && checksum_ok (p, sizeof (struct mp_fp)))
+      return (struct mp_fp *) p;
+  return NULL;
+}
+
+/* Returns true if the SIZE bytes at P sum to zero. */
+static bool
+checksum_ok (const void *p_, size_t size)
+{
+  const uint8_t *p = p_;
+  uint8_t sum = 0;
+
+  while (size-- > 0)
+    sum += *p++;
+  return sum == 0;
+}
+
+/* Reschedule IPI handler.  The CPU that sent it has put a
+   thread on our run queue. */
+static void
+resched_interrupt (struct intr_frame *args UNUSED)
+{
+  intr_yield_on_return ();
+}
@@ -0,0 +1,59 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/spinlock.h"
+
+/* Maximum number of CPUs supported. */
+#define CPU_MAX 8
+
+/* Number of buckets in each CPU's histogram of ready-queue wait
+   times; see thread.c. */
+#define WAIT_HIST_BUCKETS 64
+
+/* Per-CPU data.  Each CPU finds its own through the thread it is
+   running (see cpu_current()), so members that are not protected
+   by RQ_LOCK may only be used by that CPU, with interrupts off. */
+struct cpu
+  {
+    unsigned id;                        /* Index into cpus[]. */
+    uint8_t apic_id;                    /* Local APIC ID. */
+    volatile bool online;               /* Started and scheduling? */
+    volatile bool idling;               /* Halted in the idle thread? */
+    struct thread *idle_thread;         /* This CPU's idle thread. */
+
+    /* Run queue.  Owned by thread.c. */
+    struct spinlock rq_lock;            /* Protects the members below. */
+    struct list ready_list;             /* Threads ready to run here. */
+    unsigned ready_cnt;                 /* Number of threads in ready_list. */
+
+    /* Owned by interrupt.c. */
+    bool in_external_intr;              /* Processing an external interrupt? */
+    bool yield_on_return;               /* Yield on interrupt return? */
+
+    /* Scheduling state and statistics.  Owned by thread.c. */
+    unsigned thread_ticks;              /* # of timer ticks since last yield. */
+    bool preempting;                    /* Called by thread_preempt()? */
+    uint64_t idle_cycles;               /* timer_cycles() spent idle. */
+    uint64_t kernel_cycles;             /* ...in kernel threads. */
+    uint64_t user_cycles;               /* ...in user programs. */
+    long long voluntary_switches;       /* # of switches away by choice. */
+    long long involuntary_switches;     /* # of switches by preemption. */
+    long long steals;                   /* # of times work was stolen. */
+    long long migrations;               /* # of threads run after another CPU. */
+    uint64_t max_wait_cycles;           /* Longest ready wait seen. */
+    long long wait_hist[WAIT_HIST_BUCKETS]; /* Ready wait histogram. */
+  };
+
+/* All CPUs found at boot, the bootstrap processor first. */
+extern struct cpu cpus[CPU_MAX];
+extern unsigned cpu_cnt;
+
+void cpu_init (void);
+void cpu_start_aps (void);
+struct cpu *cpu_current (void);
+void cpu_kick (struct cpu *);
+
+#endif /* threads/cpu.h */
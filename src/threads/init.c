@@ -13,12 +13,16 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -35,6 +39,11 @@
 #include "filesys/fsutil.h"
 #include "filesys/directory.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 
 /* Amount of physical memory, in 4 kB pages. */
 size_t ram_pages;
@@ -54,6 +63,11 @@ bool force_off_when_done = false;
 /* -tcf: Simulate failure in thread_create klaar@ida... */
 int thread_create_limit = 0; /* infinite */
 
+/* -lp: Number of most contended locks to print at power off. */
+static int lock_profile_cnt;
+/* -prof: Timer ticks per profile sample, or 0 not to profile. */
+static int profile_divisor;
+
 static void ram_init (void);
 static void paging_init (void);
 
@@ -83,7 +97,9 @@ main (void)
   /* Initialize ourselves as a thread so we can use locks,
      then enable console locking. */
   thread_init ();
+#ifdef USERPROG
   process_init ();
+#endif
   console_init ();  
   
   /* Greet user. */
@@ -93,6 +109,8 @@ main (void)
   palloc_init ();
   malloc_init ();
   paging_init ();
+  if (profile_divisor > 0)
+    profile_init (profile_divisor);
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -115,12 +133,20 @@ main (void)
   serial_init_queue ();
   timer_calibrate ();
 
+  /* Start the other CPUs, if any. */
+  cpu_start_aps ();
+
 #ifdef FILESYS
   /* Initialize file system. */
   disk_init ();
   filesys_init (format_filesys);
   dir_init();
 #endif
+#ifdef VM
+  /* Initialize virtual memory. */
+  frame_init ();
+  swap_init ();
+#endif
 
   printf ("Boot complete.\n");
   
@@ -167,7 +193,7 @@ paging_init (void)
   size_t page;
   extern char _start, _end_kernel_text;
 
-  pd = base_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  pd = base_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO | PAL_KERNEL_PD);
   pt = NULL;
   for (page = 0; page < ram_pages; page++) 
     {
@@ -179,7 +205,7 @@ paging_init (void)
 
       if (pd[pde_idx] == 0)
         {
-          pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+          pt = palloc_get_page (PAL_ASSERT | PAL_ZERO | PAL_KERNEL_PD);
           pd[pde_idx] = pde_create (pt);
         }
 
@@ -254,13 +280,27 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-lpt"))
+        timer_set_loops_per_tick (atoi (value));
+      else if (!strcmp (name, "-tsc"))
+        timer_set_tsc_per_tick (atoi (value));
+      else if (!strcmp (name, "-lp"))
+        lock_profile_cnt = atoi (value);
+      else if (!strcmp (name, "-prof"))
+        profile_divisor = value != NULL ? atoi (value) : 1;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
       else if (!strcmp (name, "-fl")) // klaar@ida
         free_page_limit = atoi (value);
+      else if (!strcmp (name, "-kr"))
+        kernel_page_reserve = atoi (value);
       else if (!strcmp (name, "-tcl")) // klaar@ida
         thread_create_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        stack_page_limit = atoi (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -364,10 +404,18 @@ usage (void)
           "  -f                 Format file system disk during startup.\n"
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -lpt=N             Skip timer calibration: N loops per tick.\n"
+          "  -tsc=N             Skip TSC calibration: N cycles per tick.\n"
+          "  -lp=N              Print the N most contended locks at exit.\n"
+          "  -prof[=N]          Sample where CPU time goes every N ticks.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
           "  -fl=COUNT          Limit free memory to COUNT pages.\n"
+          "  -kr=COUNT          Keep COUNT free pages from user processes.\n"
           "  -tcl=N             Fail at call N to thread_create.\n"
+#endif
+#ifdef VM
+          "  -sl=COUNT          Let user stacks grow to COUNT pages.\n"
 #endif
           );
 
@@ -394,6 +442,8 @@ power_off (void)
 #endif
 
   print_stats ();
+  palloc_report_leaks ();
+  malloc_report_leaks ();
 
   printf ("Powering off...\n");
   serial_flush ();
@@ -420,6 +470,9 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  palloc_print_stats ();
+  malloc_print_stats ();
+  kmem_cache_print_stats ();
 #ifdef FILESYS
   disk_print_stats ();
 #endif
@@ -427,5 +480,14 @@ print_stats (void)
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
+  process_print_stats ();
+#endif
+#ifdef VM
+  page_print_stats ();
+  frame_print_stats ();
+  swap_print_stats ();
 #endif
+  if (lock_profile_cnt > 0)
+    lock_print_profile (lock_profile_cnt);
+  profile_print_stats ();
 }
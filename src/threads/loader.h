@@ -17,6 +17,11 @@
    This must be aligned on a 4 MB boundary. */
 #define LOADER_PHYS_BASE 0xc0000000     /* 3 GB. */
 
+/* Physical address to which threads/ap-start.S is copied, and
+   at which application processors begin executing.  Must be
+   page-aligned, below 1 MB, and clear of the loader. */
+#define LOADER_AP_START 0x8000
+
 /* Important loader physical addresses. */
 #define LOADER_SIG (LOADER_END - LOADER_SIG_LEN)   /* 0xaa55 BIOS signature. */
 #define LOADER_ARGS (LOADER_SIG - LOADER_ARGS_LEN)     /* Command-line args. */
@@ -5,7 +5,9 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
+#include "threads/spinlock.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -13,34 +15,53 @@
 
    The size of each request, in bytes, is rounded up to a power
    of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
+   that size, which a table indexed by size finds in constant
+   time.  The descriptor keeps a list of the arenas (see below)
+   that have free blocks, and each arena keeps a list of its own
+   free blocks.  If the descriptor's list is nonempty, a block
+   from its first arena is used to satisfy the request.
 
    Otherwise, a new page of memory, called an "arena", is
    obtained from the page allocator (if none is available,
    malloc() returns a null pointer).  The new arena is divided
-   into blocks, all of which are added to the descriptor's free
-   list.  Then we return one of the new blocks.
+   into blocks, all of which are added to the arena's free list.
+   Then we return one of the new blocks.
 
-   When we free a block, we add it to its descriptor's free list.
-   But if the arena that the block was in now has no in-use
-   blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
+   When we free a block, we add it to its arena's free list.  If
+   the arena now has no in-use blocks, it goes back to the page
+   allocator, which takes constant time because its blocks are
+   on no list but its own.  Each descriptor holds on to one empty
+   arena, though, so that a block being allocated and freed over
+   and over does not cost a page each time.
 
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   Every block is tagged with what it is for (see malloc_tag):
+   an arena keeps one tag byte per block between its header and
+   its first block, and a big block keeps its tag in its arena
+   header.  malloc_print_stats() reports how many bytes each tag
+   holds and held at most.  Unlike palloc's page counts, these
+   are not kept per process, since a block is often freed by a
+   different thread from the one that allocated it. */
 
 /* Descriptor. */
 struct desc
   {
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
-    struct list free_list;      /* List of free blocks. */
+    size_t block_ofs;           /* Offset of an arena's first block. */
+    struct list arenas;         /* Arenas with free blocks. */
+    size_t empty_cnt;           /* Arenas with no blocks in use. */
     struct lock lock;           /* Lock. */
+
+    /* Statistics. */
+    size_t arena_cnt;           /* Number of arenas. */
+    size_t in_use;              /* Number of blocks in use. */
+    size_t peak_in_use;         /* Highest value of IN_USE. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -52,6 +73,9 @@ struct arena
     unsigned magic;             /* Always set to ARENA_MAGIC. */
     struct desc *desc;          /* Owning descriptor, null for big block. */
     size_t free_cnt;            /* Free blocks; pages in big block. */
+    enum malloc_tag tag;        /* Tag of big block. */
+    struct list free_list;      /* List of free blocks. */
+    struct list_elem elem;      /* In desc's `arenas', unless full. */
   };
 
 /* Free block. */
@@ -64,23 +88,69 @@ struct block
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Smallest and largest block sizes handled by descriptors. */
+#define MIN_BLOCK 16
+#define MAX_BLOCK (PGSIZE / 4)
+
+/* Alignment of an arena's first block. */
+#define BLOCK_ALIGN 8
+
+/* The descriptor for each request size, in MIN_BLOCK steps:
+   SIZE bytes are served by size_descs[DIV_ROUND_UP (SIZE,
+   MIN_BLOCK)]. */
+static struct desc *size_descs[MAX_BLOCK / MIN_BLOCK + 1];
+
+/* Names of the tags, for statistics. */
+static const char *tag_names[MALLOC_TAG_CNT] =
+  {"other", "filesys", "process", "vm"};
+
+/* Bytes in use by each tag, and at most.  Every descriptor
+   updates these, so they have a lock of their own, a spinlock
+   since it is only held for a moment. */
+static size_t tag_bytes[MALLOC_TAG_CNT];
+static size_t tag_peak[MALLOC_TAG_CNT];
+static struct spinlock tag_lock;
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static uint8_t *block_tag (struct arena *, struct block *);
+static struct arena *new_arena (struct desc *);
+static void account (enum malloc_tag, size_t bytes, bool alloc);
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) 
 {
   size_t block_size;
+  size_t i;
 
-  for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+  for (block_size = MIN_BLOCK; block_size <= MAX_BLOCK; block_size *= 2)
     {
       struct desc *d = &descs[desc_cnt++];
       ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
       d->block_size = block_size;
-      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-      list_init (&d->free_list);
-      lock_init (&d->lock);
+
+      /* Room for each block and its tag byte. */
+      d->blocks_per_arena = ((PGSIZE - sizeof (struct arena))
+                             / (block_size + 1));
+      d->block_ofs = ROUND_UP (sizeof (struct arena) + d->blocks_per_arena,
+                               BLOCK_ALIGN);
+      if (d->block_ofs + d->blocks_per_arena * block_size > PGSIZE)
+        d->blocks_per_arena--;
+      list_init (&d->arenas);
+      d->empty_cnt = 0;
+      lock_init_named (&d->lock, "malloc");
+      d->arena_cnt = d->in_use = d->peak_in_use = 0;
+    }
+  spinlock_init (&tag_lock);
+
+  /* Size 0 is never looked up, but give it a descriptor anyway. */
+  for (i = 0; i < sizeof size_descs / sizeof *size_descs; i++) 
+    {
+      struct desc *d = descs;
+      while (d->block_size < i * MIN_BLOCK)
+        d++;
+      size_descs[i] = d;
     }
 }
 
@@ -88,6 +158,13 @@ malloc_init (void)
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) 
+{
+  return malloc_tagged (size, MALLOC_OTHER);
+}
+
+/* Like malloc(), but counts the block under TAG. */
+void *
+malloc_tagged (size_t size, enum malloc_tag tag) 
 {
   struct desc *d;
   struct block *b;
@@ -99,15 +176,12 @@ malloc (size_t size)
 
   /* Find the smallest descriptor that satisfies a SIZE-byte
      request. */
-  for (d = descs; d < descs + desc_cnt; d++)
-    if (d->block_size >= size)
-      break;
-  if (d == descs + desc_cnt) 
+  if (size > MAX_BLOCK) 
     {
       /* SIZE is too big for any descriptor.
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
-      a = palloc_get_multiple (0, page_cnt);
+      a = palloc_get_multiple (PAL_MALLOC_BIG, page_cnt);
       if (a == NULL)
         return NULL;
 
@@ -116,40 +190,41 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = NULL;
       a->free_cnt = page_cnt;
+      a->tag = tag;
+      account (tag, PGSIZE * page_cnt, true);
       return a + 1;
     }
 
+  d = size_descs[DIV_ROUND_UP (size, MIN_BLOCK)];
+
   lock_acquire (&d->lock);
 
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
+  /* If no arena has a free block, create a new arena.  Set it up
+     without holding the lock. */
+  if (list_empty (&d->arenas))
     {
-      size_t i;
-
-      /* Allocate a page. */
-      a = palloc_get_page (0);
+      lock_release (&d->lock);
+      a = new_arena (d);
       if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
-
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
-        {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
-        }
+        return NULL; 
+      lock_acquire (&d->lock);
+      list_push_front (&d->arenas, &a->elem);
+      d->empty_cnt++;
+      d->arena_cnt++;
     }
 
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
+  /* Get a block from the first arena's free list and return it. */
+  a = list_entry (list_front (&d->arenas), struct arena, elem);
+  if (a->free_cnt == d->blocks_per_arena)
+    d->empty_cnt--;
+  b = list_entry (list_pop_front (&a->free_list), struct block, free_elem);
+  if (--a->free_cnt == 0)
+    list_remove (&a->elem);
+  if (++d->in_use > d->peak_in_use)
+    d->peak_in_use = d->in_use;
+  *block_tag (a, b) = tag;
   lock_release (&d->lock);
+  account (tag, d->block_size, true);
   return b;
 }
 
@@ -201,7 +276,17 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      void *new_block;
+
+      if (old_block != NULL) 
+        {
+          struct arena *a = block_to_arena (old_block);
+          new_block = malloc_tagged (new_size,
+                                     a->desc != NULL
+                                     ? *block_tag (a, old_block) : a->tag);
+        }
+      else
+        new_block = malloc (new_size);
       if (old_block != NULL && new_block != NULL)
         {
           size_t old_size = block_size (old_block);
@@ -227,42 +312,118 @@ free (void *p)
       if (d != NULL) 
         {
           /* It's a normal block.  We handle it here. */
+          account (*block_tag (a, b), d->block_size, false);
 
 #ifndef NDEBUG
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
   
+          bool free_arena = false;
+
           lock_acquire (&d->lock);
 
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
+          /* Add block to its arena's free list. */
+          list_push_front (&a->free_list, &b->free_elem);
+          if (++a->free_cnt == 1)
+            list_push_front (&d->arenas, &a->elem);
+          d->in_use--;
 
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          /* If the arena is now entirely unused, free it, unless
+             it is the one empty arena we keep. */
+          if (a->free_cnt >= d->blocks_per_arena) 
             {
-              size_t i;
-
               ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
+              if (d->empty_cnt > 0) 
                 {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
+                  list_remove (&a->elem);
+                  d->arena_cnt--;
+                  free_arena = true;
                 }
-              palloc_free_page (a);
+              else
+                d->empty_cnt++;
             }
 
           lock_release (&d->lock);
+          if (free_arena)
+            palloc_free_page (a);
         }
       else
         {
           /* It's a big block.  Free its pages. */
+          account (a->tag, PGSIZE * a->free_cnt, false);
           palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
 }
 
+/* Prints how many blocks of each size are in use, and how many
+   were at most, and how many bytes each tag holds and held at
+   most, counting big blocks in whole pages.  Pages for blocks
+   bigger than the largest size are also counted by
+   palloc_print_stats(). */
+void
+malloc_print_stats (void) 
+{
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++) 
+    {
+      struct desc *d = &descs[i];
+
+      if (d->peak_in_use > 0)
+        printf ("Malloc: %zu-byte blocks: %zu in use (%zu bytes), "
+                "peak %zu, %zu arenas\n",
+                d->block_size, d->in_use, d->in_use * d->block_size,
+                d->peak_in_use, d->arena_cnt);
+    }
+  for (i = 0; i < MALLOC_TAG_CNT; i++)
+    if (tag_peak[i] > 0)
+      printf ("Malloc: %s: %zu bytes in use, peak %zu bytes\n",
+              tag_names[i], tag_bytes[i], tag_peak[i]);
+}
+
+/* Reports the bytes still allocated for user processes and
+   virtual memory.  Called at power off, like
+   palloc_report_leaks(), which explains when that is
+   meaningful. */
+void
+malloc_report_leaks (void) 
+{
+  static const enum malloc_tag leak_tags[] = {MALLOC_PROCESS, MALLOC_VM};
+  size_t i;
+
+  for (i = 0; i < sizeof leak_tags / sizeof *leak_tags; i++) 
+    if (tag_bytes[leak_tags[i]] > 0)
+      printf ("Malloc: leak check: %zu %s bytes still allocated\n",
+              tag_bytes[leak_tags[i]], tag_names[leak_tags[i]]);
+}
+
+/* Obtains a page from the page allocator and sets it up as an
+   arena for descriptor D, with all of its blocks free.  Returns a
+   null pointer if no page is available. */
+static struct arena *
+new_arena (struct desc *d) 
+{
+  struct arena *a = palloc_get_page (PAL_MALLOC);
+  size_t i;
+
+  if (a == NULL)
+    return NULL;
+
+  a->magic = ARENA_MAGIC;
+  a->desc = d;
+  a->free_cnt = d->blocks_per_arena;
+  list_init (&a->free_list);
+  for (i = 0; i < d->blocks_per_arena; i++) 
+    {
+      struct block *b = arena_to_block (a, i);
+      list_push_back (&a->free_list, &b->free_elem);
+    }
+  return a;
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
@@ -275,7 +436,7 @@ block_to_arena (struct block *b)
 
   /* Check that the block is properly aligned for the arena. */
   ASSERT (a->desc == NULL
-          || (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+          || (pg_ofs (b) - a->desc->block_ofs) % a->desc->block_size == 0);
   ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
 
   return a;
@@ -289,6 +450,37 @@ arena_to_block (struct arena *a, size_t idx)
   ASSERT (a->magic == ARENA_MAGIC);
   ASSERT (idx < a->desc->blocks_per_arena);
   return (struct block *) ((uint8_t *) a
-                           + sizeof *a
+                           + a->desc->block_ofs
                            + idx * a->desc->block_size);
 }
+
+/* Returns the tag byte of block B in arena A. */
+static uint8_t *
+block_tag (struct arena *a, struct block *b) 
+{
+  size_t idx = (pg_ofs (b) - a->desc->block_ofs) / a->desc->block_size;
+
+  ASSERT (idx < a->desc->blocks_per_arena);
+  return (uint8_t *) (a + 1) + idx;
+}
+
+/* Counts BYTES bytes with tag TAG as allocated, if ALLOC is
+   true, or as freed. */
+static void
+account (enum malloc_tag tag, size_t bytes, bool alloc) 
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  spinlock_acquire (&tag_lock);
+  if (alloc) 
+    {
+      tag_bytes[tag] += bytes;
+      if (tag_bytes[tag] > tag_peak[tag])
+        tag_peak[tag] = tag_bytes[tag];
+    }
+  else
+    tag_bytes[tag] -= bytes;
+  spinlock_release (&tag_lock);
+  intr_set_level (old_level);
+}
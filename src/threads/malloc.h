@@ -4,10 +4,23 @@
 #include <debug.h>
 #include <stddef.h>
 
+/* What a block is for, for memory accounting. */
+enum malloc_tag
+  {
+    MALLOC_OTHER,               /* None of the below. */
+    MALLOC_FILESYS,             /* File system sector buffers. */
+    MALLOC_PROCESS,             /* State of one user process. */
+    MALLOC_VM,                  /* Frame and supplemental page tables. */
+    MALLOC_TAG_CNT
+  };
+
 void malloc_init (void);
 void *malloc (size_t) __attribute__ ((malloc));
+void *malloc_tagged (size_t, enum malloc_tag) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+void malloc_print_stats (void);
+void malloc_report_leaks (void);
 
 #endif /* threads/malloc.h */
@@ -1,49 +1,159 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
+#include "threads/spinlock.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
    hands out smaller chunks.
 
-   System memory is divided into two "pools" called the kernel
-   and user pools.  The user pool is for user (virtual) memory
-   pages, the kernel pool for everything else.  The idea here is
-   that the kernel needs to have memory for its own operations
-   even if user processes are swapping like mad.
+   All free memory is in one pool, from which the kernel and user
+   processes (PAL_USER) both allocate.  The kernel needs to have
+   memory for its own operations even if user processes are
+   swapping like mad, so user pages are held back by watermarks:
 
-   By default, half of system RAM is given to the kernel pool and
-   half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+      - User allocations may not take the last kernel_page_reserve
+        free pages (-kr, by default an eighth of memory).
+
+      - Beyond a soft limit of half of memory, user allocations
+        may only borrow pages while more than twice the kernel
+        reserve is free.
+
+      - user_page_limit (-ul) is a hard cap on user pages.
+
+   The kernel may take any free page.  So either side can use
+   memory the other is not using, instead of each being stuck
+   with a fixed half.
+
+   The pool is a binary buddy allocator.  Free memory is kept as
+   blocks of 2**ORDER pages, aligned to their size, on one free
+   list per order.  An allocation takes a block of the smallest
+   order that fits, splitting a bigger block in halves ("buddies")
+   if it must, and gives back the pages it does not need.  A freed
+   block is merged with its buddy for as long as the buddy is free
+   too.  So single pages come and go in constant time, bigger runs
+   in time logarithmic in the pool size, and freed memory does not
+   stay fragmented into pieces smaller than it has to be.
+
+   The free lists are threaded through the free pages themselves.
+   Pages can be freed from schedule_tail() with interrupts off,
+   so the pool is protected by a spinlock.
+
+   Besides the buddy free lists, the pool keeps a small reserve
+   of free pages that the idle thread has already cleared (see
+   palloc_zero_idle()), so that single-page PAL_ZERO requests,
+   such as page tables and user stacks, need not spend time
+   clearing a page.  Reserve pages still count as free memory:
+   when the buddy allocator runs dry, the reserve goes back to
+   it.
+
+   Every allocation is tagged with what it is for (see
+   palloc_flags), and the tag is kept with each allocated page.
+   palloc_print_stats() reports how many pages each tag holds and
+   held at most, and how full the pool got, which is what to go
+   by when setting the watermarks.  The user and page table pages
+   of a process are also counted in its struct thread.  The
+   kernel's own page directory and page tables, which live until
+   power off, have a tag of their own, so that they are neither
+   charged to a thread nor reported as leaked. */
+
+/* Number of pre-zeroed pages the pool keeps in reserve. */
+#define ZERO_RESERVE 16
+
+/* Number of block orders.  The largest block is
+   2**(ORDER_CNT - 1) pages, or 128 MB. */
+#define ORDER_CNT 16
+
+/* State of a page, in struct pool's `page_state'. */
+#define PAGE_USED 0x80                  /* Allocated... */
+#define PAGE_TAG 0x3f                   /* ...with this tag. */
+#define PAGE_FREE_HEAD 0x40             /* First page of a free block... */
+#define PAGE_ORDER 0x3f                 /* ...of this order. */
+
+/* What allocated pages are for.  The kernel-side tags are
+   numbered as in palloc_flags. */
+enum page_tag
+  {
+    TAG_OTHER,                          /* None of the below. */
+    TAG_THREAD,                         /* PAL_THREAD. */
+    TAG_PAGEDIR,                        /* PAL_PAGEDIR. */
+    TAG_MALLOC,                         /* PAL_MALLOC. */
+    TAG_MALLOC_BIG,                     /* PAL_MALLOC_BIG. */
+    TAG_SLAB,                           /* PAL_SLAB. */
+    TAG_KERNEL_PD,                      /* PAL_KERNEL_PD. */
+    TAG_USER,                           /* PAL_USER. */
+    TAG_CNT
+  };
+
+/* Names of the tags, for statistics. */
+static const char *tag_names[TAG_CNT] =
+  {"other", "thread", "pagedir", "malloc", "malloc big", "slab",
+   "kernel pagedir", "user"};
+
+/* Number of pages of each kind listed by palloc_report_leaks(). */
+#define LEAK_MAX 8
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct spinlock lock;               /* Mutual exclusion. */
+    uint8_t *page_state;                /* State of each page, see above. */
+    size_t page_cnt;                    /* Number of pages. */
+    size_t free_cnt;                    /* Number of free pages. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks of each order. */
+    struct list zeroed;                 /* Reserve of pre-zeroed pages. */
+    size_t zeroed_cnt;                  /* Number of pages in reserve. */
     uint8_t *base;                      /* Base of pool. */
+
+    /* Statistics. */
+    unsigned long long idle_zeroed;     /* Pages zeroed by idle thread. */
+    unsigned long long reserve_hits;    /* PAL_ZERO pages from reserve. */
+    unsigned long long demand_zeroed;   /* PAL_ZERO pages zeroed on demand. */
+    unsigned long long user_denied;     /* User allocations held back. */
+    size_t peak_used;                   /* Most pages ever in use. */
+    size_t tag_pages[TAG_CNT];          /* Pages in use by each tag. */
+    size_t tag_peak[TAG_CNT];           /* Most pages ever in use by each. */
+    unsigned long long tag_allocs[TAG_CNT]; /* Allocations by each tag. */
   };
 
-/* Two pools: one for kernel data, one for user pages. */
-struct pool kernel_pool, user_pool;
+/* The pool of all free pages. */
+static struct pool page_pool;
 
-/* Maximum number of pages to put in user pool. */
+/* Maximum number of user pages. */
 size_t user_page_limit = SIZE_MAX;
 size_t free_page_limit = SIZE_MAX; // klaar@ida
 
+/* Number of free pages user allocations leave for the kernel.
+   SIZE_MAX means an eighth of memory. */
+size_t kernel_page_reserve = SIZE_MAX;
+
+/* Number of user pages beyond which user allocations only borrow
+   pages while plenty are free. */
+static size_t user_soft_limit;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static bool user_may_take (struct pool *, size_t page_cnt);
+static bool alloc_block (struct pool *, int order, size_t *page_idx);
+static void free_block (struct pool *, size_t page_idx, int order);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static bool take_zeroed (struct pool *, size_t *page_idx);
+static void account (struct pool *, int tag, size_t page_cnt, bool alloc);
+static void drain_zeroed (struct pool *);
+static bool zero_page (struct pool *);
+static void print_pool (const char *name, struct pool *);
 
 /* Initializes the page allocator. */
 void
@@ -57,52 +167,84 @@ palloc_init (void)
   uint8_t *free_start = pg_round_up (&_end);
   uint8_t *free_end = ptov (ram_pages * PGSIZE);
   size_t free_pages = (free_end - free_start) / PGSIZE;
-  size_t user_pages;
-  size_t kernel_pages;
   
   if (free_pages > free_page_limit) // klaar@ida
     free_pages = free_page_limit;
-  
-  user_pages = free_pages / 2;
-  if (user_pages > user_page_limit)
-    user_pages = user_page_limit;
-  
-  kernel_pages = free_pages - user_pages;
 
-  /* Give half of memory to kernel, half to user. */
-  init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
-  init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
-             user_pages, "user pool");
+  init_pool (&page_pool, free_start, free_pages, "page pool");
+
+  if (kernel_page_reserve > page_pool.page_cnt)
+    kernel_page_reserve = page_pool.page_cnt / 8;
+  user_soft_limit = page_pool.page_cnt / 2;
+  printf ("%zu pages reserved for the kernel, user soft limit %zu pages.\n",
+          kernel_page_reserve, user_soft_limit);
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
-   If PAL_USER is set, the pages are obtained from the user pool,
-   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
+   If PAL_USER is set, the pages are for user memory and subject
+   to the user watermarks.  If PAL_ZERO is set in FLAGS,
    then the pages are filled with zeros.  If too few pages are
    available, returns a null pointer, unless PAL_ASSERT is set in
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
-  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-  void *pages;
+  struct pool *pool = &page_pool;
+  int tag = (flags & 0xf00) >> 8;
+  enum intr_level old_level;
+  void *pages = NULL;
+  bool zeroed = false;
+  bool found = false;
+  bool allowed;
   size_t page_idx;
+  int order;
 
+  ASSERT (tag < TAG_USER);
+  if (tag == TAG_OTHER && (flags & PAL_USER))
+    tag = TAG_USER;
   if (page_cnt == 0)
     return NULL;
+  for (order = 0; ((size_t) 1 << order) < page_cnt; order++)
+    continue;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  old_level = intr_disable ();
+  spinlock_acquire (&pool->lock);
+  allowed = tag != TAG_USER || user_may_take (pool, page_cnt);
+  if (allowed && page_cnt == 1 && (flags & PAL_ZERO))
+    zeroed = found = take_zeroed (pool, &page_idx);
+  if (allowed && !found && order < ORDER_CNT) 
+    {
+      found = alloc_block (pool, order, &page_idx);
+      if (!found && pool->zeroed_cnt > 0) 
+        {
+          drain_zeroed (pool);
+          found = alloc_block (pool, order, &page_idx);
+        }
+      if (found) 
+        {
+          /* Give back the part of the block we do not need. */
+          free_range (pool, page_idx + page_cnt,
+                      ((size_t) 1 << order) - page_cnt);
+          pool->free_cnt -= page_cnt;
+          if (flags & PAL_ZERO)
+            pool->demand_zeroed += page_cnt;
+        }
+    }
+  if (found) 
+    {
+      size_t i;
 
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+      for (i = 0; i < page_cnt; i++)
+        pool->page_state[page_idx + i] = PAGE_USED | tag;
+      account (pool, tag, page_cnt, true);
+      pages = pool->base + PGSIZE * page_idx;
+    }
+  spinlock_release (&pool->lock);
+  intr_set_level (old_level);
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if ((flags & PAL_ZERO) && !zeroed)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -116,8 +258,8 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 
 /* Obtains a single free page and returns its kernel virtual
    address.
-   If PAL_USER is set, the page is obtained from the user pool,
-   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
+   If PAL_USER is set, the page is for user memory and subject to
+   the user watermarks.  If PAL_ZERO is set in FLAGS,
    then the page is filled with zeros.  If no pages are
    available, returns a null pointer, unless PAL_ASSERT is set in
    FLAGS, in which case the kernel panics. */
@@ -131,19 +273,16 @@ palloc_get_page (enum palloc_flags flags)
 void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
-  struct pool *pool;
+  struct pool *pool = &page_pool;
+  enum intr_level old_level;
   size_t page_idx;
+  size_t i;
+  int tag;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
     return;
-
-  if (page_from_pool (&kernel_pool, pages))
-    pool = &kernel_pool;
-  else if (page_from_pool (&user_pool, pages))
-    pool = &user_pool;
-  else
-    NOT_REACHED ();
+  ASSERT (page_from_pool (pool, pages));
 
   page_idx = pg_no (pages) - pg_no (pool->base);
 
@@ -151,8 +290,19 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  old_level = intr_disable ();
+  spinlock_acquire (&pool->lock);
+  tag = pool->page_state[page_idx] & PAGE_TAG;
+  for (i = 0; i < page_cnt; i++) 
+    {
+      ASSERT (pool->page_state[page_idx + i] == (PAGE_USED | tag));
+      pool->page_state[page_idx + i] = 0;
+    }
+  free_range (pool, page_idx, page_cnt);
+  pool->free_cnt += page_cnt;
+  account (pool, tag, page_cnt, false);
+  spinlock_release (&pool->lock);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -162,25 +312,140 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Moves PAGE_CNT user pages from FROM's count to TO's, for a
+   page that one process has given to another without freeing
+   it, as when one process's page is evicted to make room for
+   another's.  The pages are then counted against TO, and TO is
+   the one that must free them. */
+void
+palloc_recharge (struct thread *from, struct thread *to, size_t page_cnt) 
+{
+  struct pool *pool = &page_pool;
+  enum intr_level old_level;
+
+  if (from == to)
+    return;
+
+  old_level = intr_disable ();
+  spinlock_acquire (&pool->lock);
+  ASSERT (from->pages >= page_cnt);
+  from->pages -= page_cnt;
+  to->pages += page_cnt;
+  if (to->pages > to->peak_pages)
+    to->peak_pages = to->pages;
+  spinlock_release (&pool->lock);
+  intr_set_level (old_level);
+}
+
+/* Zeroes one free page into the pre-zeroed reserve, if the
+   reserve is not full.  Returns true if it did, false if there
+   was nothing to do.  Called by the idle thread, with interrupts
+   on, so that the clearing is done while nothing else wants to
+   run. */
+bool
+palloc_zero_idle (void) 
+{
+  return zero_page (&page_pool);
+}
+
+/* Prints how fragmented the free memory is, how many PAL_ZERO
+   pages were served from the pre-zeroed reserve, and how many
+   pages each tag holds. */
+void
+palloc_print_stats (void) 
+{
+  struct pool *pool = &page_pool;
+  int tag;
+
+  print_pool ("page pool", pool);
+  printf ("Palloc: %zu pages reserved for the kernel, user soft limit %zu, "
+          "%llu user allocations held back\n",
+          kernel_page_reserve, user_soft_limit, pool->user_denied);
+  for (tag = 0; tag < TAG_CNT; tag++) 
+    {
+      size_t live = pool->tag_pages[tag];
+
+      if (pool->tag_allocs[tag] > 0)
+        printf ("Palloc: %s pages: %zu in use (%zu kB), peak %zu, "
+                "%llu allocations\n",
+                tag_names[tag], live, live * PGSIZE / 1024,
+                pool->tag_peak[tag], pool->tag_allocs[tag]);
+    }
+}
+
+/* Lists the user pages and process page tables that are still
+   allocated.  Called at power off, when every user process
+   should have exited and given back its pages, so anything
+   listed was leaked, unless a process was still running.  So
+   the check only means something once every process has been
+   waited for: process_cleanup() gives back all of a process's
+   memory before it lets process_wait() return in the parent.
+   Everything else is normally still in use by the kernel
+   itself, and palloc_print_stats() reports how much of it there
+   is. */
+void
+palloc_report_leaks (void) 
+{
+  static const int leak_tags[] = {TAG_USER, TAG_PAGEDIR};
+  size_t i;
+
+  for (i = 0; i < sizeof leak_tags / sizeof *leak_tags; i++) 
+    {
+      int tag = leak_tags[i];
+      struct pool *pool = &page_pool;
+      size_t live = pool->tag_pages[tag];
+      size_t page_idx, shown = 0;
+
+      if (live == 0)
+        continue;
+      printf ("Palloc: leak check: %zu %s pages still allocated:", 
+              live, tag_names[tag]);
+      for (page_idx = 0; page_idx < pool->page_cnt && shown < LEAK_MAX;
+           page_idx++)
+        if (pool->page_state[page_idx] == (PAGE_USED | tag)) 
+          {
+            printf (" %p", pool->base + PGSIZE * page_idx);
+            shown++;
+          }
+      printf ("%s\n", live > shown ? " ..." : "");
+    }
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's page states at its base.
+     Calculate the space needed for them
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  size_t state_pages = DIV_ROUND_UP (page_cnt, PGSIZE);
+  int order;
+
+  if (state_pages > page_cnt)
+    PANIC ("Not enough memory in %s for page states.", name);
+  page_cnt -= state_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  /* Initialize the pool, with all of its pages free. */
+  spinlock_init (&p->lock);
+  p->page_state = base;
+  memset (p->page_state, 0, page_cnt);
+  p->page_cnt = page_cnt;
+  p->free_cnt = page_cnt;
+  for (order = 0; order < ORDER_CNT; order++)
+    list_init (&p->free_lists[order]);
+  list_init (&p->zeroed);
+  p->zeroed_cnt = 0;
+  p->idle_zeroed = p->reserve_hits = p->demand_zeroed = 0;
+  p->user_denied = 0;
+  p->peak_used = 0;
+  memset (p->tag_pages, 0, sizeof p->tag_pages);
+  memset (p->tag_peak, 0, sizeof p->tag_peak);
+  memset (p->tag_allocs, 0, sizeof p->tag_allocs);
+  p->base = base + state_pages * PGSIZE;
+  free_range (p, 0, page_cnt);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -190,7 +455,268 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns true if the watermarks let PAGE_CNT more user pages be
+   allocated from POOL, and counts the allocation as held back
+   otherwise.  POOL's lock must be held. */
+static bool
+user_may_take (struct pool *pool, size_t page_cnt) 
+{
+  size_t user = pool->tag_pages[TAG_USER] + page_cnt;
+  size_t free_cnt = pool->free_cnt + pool->zeroed_cnt;
+
+  if (user > user_page_limit
+      || free_cnt < kernel_page_reserve + page_cnt
+      || (user > user_soft_limit
+          && free_cnt < 2 * kernel_page_reserve + page_cnt)) 
+    {
+      pool->user_denied++;
+      return false;
+    }
+  return true;
+}
+
+/* Returns the list element kept in free page PAGE_IDX of POOL. */
+static inline struct list_elem *
+free_elem (struct pool *pool, size_t page_idx) 
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Takes a free block of 2**ORDER pages out of POOL, splitting a
+   bigger one if necessary, and stores the index of its first page
+   in *PAGE_IDX.  Returns false if there is no block big enough.
+   POOL's lock must be held. */
+static bool
+alloc_block (struct pool *pool, int order, size_t *page_idx) 
+{
+  int o;
+
+  for (o = order; o < ORDER_CNT; o++)
+    if (!list_empty (&pool->free_lists[o]))
+      break;
+  if (o == ORDER_CNT)
+    return false;
+
+  *page_idx = ((uint8_t *) list_pop_front (&pool->free_lists[o])
+               - pool->base) / PGSIZE;
+  pool->page_state[*page_idx] = 0;
+
+  /* Split off the upper halves until the block is as small as
+     wanted. */
+  while (o > order) 
+    {
+      size_t buddy;
+
+      o--;
+      buddy = *page_idx + ((size_t) 1 << o);
+      pool->page_state[buddy] = PAGE_FREE_HEAD | o;
+      list_push_front (&pool->free_lists[o], free_elem (pool, buddy));
+    }
+  return true;
+}
+
+/* Puts the free block of 2**ORDER pages that starts at PAGE_IDX
+   back into POOL, merging it with its buddy, and the result with
+   its buddy, and so on, as long as the buddies are free.  POOL's
+   lock must be held. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order) 
+{
+  while (order + 1 < ORDER_CNT) 
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+      if (buddy + ((size_t) 1 << order) > pool->page_cnt
+          || pool->page_state[buddy] != (PAGE_FREE_HEAD | order))
+        break;
+      list_remove (free_elem (pool, buddy));
+      pool->page_state[buddy] = 0;
+      page_idx &= ~((size_t) 1 << order);
+      order++;
+    }
+  pool->page_state[page_idx] = PAGE_FREE_HEAD | order;
+  list_push_front (&pool->free_lists[order], free_elem (pool, page_idx));
+}
+
+/* Puts the PAGE_CNT free pages starting at PAGE_IDX back into
+   POOL, as the biggest aligned blocks they can be divided into.
+   POOL's lock must be held. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  while (page_cnt > 0) 
+    {
+      int order = 0;
+
+      while (order + 1 < ORDER_CNT
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Takes a page out of POOL's pre-zeroed reserve and stores its
+   index in *PAGE_IDX.  Returns false if the reserve is empty.
+   POOL's lock must be held. */
+static bool
+take_zeroed (struct pool *pool, size_t *page_idx) 
+{
+  struct list_elem *e;
+
+  if (list_empty (&pool->zeroed))
+    return false;
+  e = list_pop_front (&pool->zeroed);
+  pool->zeroed_cnt--;
+  pool->reserve_hits++;
+
+  /* The list element was kept in the page itself. */
+  memset (e, 0, sizeof *e);
+  *page_idx = ((uint8_t *) e - pool->base) / PGSIZE;
+  return true;
+}
+
+/* Counts PAGE_CNT pages with tag TAG in POOL as allocated, if
+   ALLOC is true, or as freed.  User pages and page tables are
+   also counted against the running thread, which is the process
+   that they belong to.  POOL's lock must be held. */
+static void
+account (struct pool *pool, int tag, size_t page_cnt, bool alloc) 
+{
+  size_t used;
+
+  if (alloc) 
+    {
+      pool->tag_pages[tag] += page_cnt;
+      pool->tag_allocs[tag]++;
+      if (pool->tag_pages[tag] > pool->tag_peak[tag])
+        pool->tag_peak[tag] = pool->tag_pages[tag];
+      used = pool->page_cnt - pool->free_cnt - pool->zeroed_cnt;
+      if (used > pool->peak_used)
+        pool->peak_used = used;
+    }
+  else
+    pool->tag_pages[tag] -= page_cnt;
+
+  if (tag == TAG_USER || tag == TAG_PAGEDIR) 
+    {
+      struct thread *t = thread_current ();
+
+      if (alloc) 
+        {
+          t->pages += page_cnt;
+          if (t->pages > t->peak_pages)
+            t->peak_pages = t->pages;
+        }
+      else 
+        {
+          ASSERT (t->pages >= page_cnt);
+          t->pages -= page_cnt;
+        }
+    }
+}
+
+/* Gives all of the pages in POOL's pre-zeroed reserve back to
+   the buddy allocator.  POOL's lock must be held. */
+static void
+drain_zeroed (struct pool *pool) 
+{
+  while (!list_empty (&pool->zeroed)) 
+    {
+      uint8_t *page = (uint8_t *) list_pop_front (&pool->zeroed);
+      size_t page_idx = (page - pool->base) / PGSIZE;
+
+      pool->page_state[page_idx] = 0;
+      free_range (pool, page_idx, 1);
+      pool->free_cnt++;
+    }
+  pool->zeroed_cnt = 0;
+}
+
+/* Takes a free page from POOL, zeroes it, and adds it to POOL's
+   reserve, unless the reserve is full or POOL is out of pages.
+   Returns true if a page was added. */
+static bool
+zero_page (struct pool *pool) 
+{
+  enum intr_level old_level;
+  size_t page_idx;
+  uint8_t *page;
+  bool ok;
+
+  old_level = intr_disable ();
+  spinlock_acquire (&pool->lock);
+  ok = (pool->zeroed_cnt < ZERO_RESERVE
+        && pool->free_cnt > ZERO_RESERVE
+        && alloc_block (pool, 0, &page_idx));
+  if (ok) 
+    {
+      pool->page_state[page_idx] = PAGE_USED;
+      pool->free_cnt--;
+    }
+  spinlock_release (&pool->lock);
+  intr_set_level (old_level);
+  if (!ok)
+    return false;
+
+  /* Clear the page without holding the lock, with interrupts
+     back on. */
+  page = pool->base + PGSIZE * page_idx;
+  memset (page, 0, PGSIZE);
+
+  old_level = intr_disable ();
+  spinlock_acquire (&pool->lock);
+  list_push_front (&pool->zeroed, (struct list_elem *) page);
+  pool->zeroed_cnt++;
+  pool->idle_zeroed++;
+  spinlock_release (&pool->lock);
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Prints how many free blocks of each order POOL has, and the
+   state of its pre-zeroed reserve. */
+static void
+print_pool (const char *name, struct pool *pool) 
+{
+  size_t blocks[ORDER_CNT];
+  unsigned long long idle_zeroed, reserve_hits, demand_zeroed;
+  enum intr_level old_level;
+  size_t free_cnt, zeroed_cnt, peak_used;
+  int order, top;
+
+  old_level = intr_disable ();
+  spinlock_acquire (&pool->lock);
+  free_cnt = pool->free_cnt;
+  for (order = 0; order < ORDER_CNT; order++)
+    blocks[order] = list_size (&pool->free_lists[order]);
+  zeroed_cnt = pool->zeroed_cnt;
+  idle_zeroed = pool->idle_zeroed;
+  reserve_hits = pool->reserve_hits;
+  demand_zeroed = pool->demand_zeroed;
+  peak_used = pool->peak_used;
+  spinlock_release (&pool->lock);
+  intr_set_level (old_level);
+
+  for (top = ORDER_CNT - 1; top > 0 && blocks[top] == 0; top--)
+    continue;
+  printf ("Palloc: %s: %zu of %zu pages free, at most %zu in use, "
+          "largest block %zu pages\n",
+          name, free_cnt, pool->page_cnt, peak_used,
+          blocks[top] > 0 ? (size_t) 1 << top : 0);
+  printf ("Palloc: %s: free blocks by order:", name);
+  for (order = 0; order <= top; order++)
+    printf (" %zu", blocks[order]);
+  printf ("\n");
+  printf ("Palloc: %s: %zu pre-zeroed pages in reserve, %llu zeroed "
+          "by idle; PAL_ZERO: %llu pages from reserve, %llu zeroed "
+          "on demand\n",
+          name, zeroed_cnt, idle_zeroed, reserve_hits, demand_zeroed);
+}
@@ -1,24 +1,45 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
+struct thread;
+
 /* How to allocate pages. */
 enum palloc_flags
   {
     PAL_ASSERT = 001,           /* Panic on failure. */
     PAL_ZERO = 002,             /* Zero page contents. */
-    PAL_USER = 004              /* User page. */
+    PAL_USER = 004,             /* User page. */
+
+    /* What the pages are for, for memory accounting.  At most one
+       of these.  Pages without one count as "other", or as "user"
+       with PAL_USER. */
+    PAL_THREAD = 0x100,         /* Thread structure and kernel stack. */
+    PAL_PAGEDIR = 0x200,        /* Process page directory or page table. */
+    PAL_MALLOC = 0x300,         /* malloc() arena. */
+    PAL_MALLOC_BIG = 0x400,     /* malloc() block bigger than an arena. */
+    PAL_SLAB = 0x500,           /* Object cache slab. */
+    PAL_KERNEL_PD = 0x600       /* Kernel page directory or page table. */
   };
 
-/* Maximum number of pages to put in user pool. */
+/* Maximum number of user pages. */
 extern size_t user_page_limit;
 extern size_t free_page_limit; // klaar@ida
 
+/* Number of free pages user allocations leave for the kernel. */
+extern size_t kernel_page_reserve;
+
 void palloc_init (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_recharge (struct thread *from, struct thread *to,
+                      size_t page_cnt);
+bool palloc_zero_idle (void);
+void palloc_print_stats (void);
+void palloc_report_leaks (void);
 
 #endif /* threads/palloc.h */
@@ -0,0 +1,210 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/spinlock.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Sampling profiler.
+
+   When enabled with the kernel's -prof option, every CPU's timer
+   interrupt records the address of the instruction it
+   interrupted, once every DIVISOR ticks, into a buffer allocated
+   at startup.  At power off, profile_print_stats() counts the
+   samples by address and prints the addresses that were hit most
+   often.  The kernel has no symbol table of its own at run time,
+   so the addresses are printed raw, for utils/backtrace to turn
+   into function names: kernel addresses against kernel.o and
+   user addresses against the program named next to them.
+
+   Time that the bootstrap processor spends idle with its tick
+   stopped (see devices/timer.c) is not sampled. */
+
+/* Number of pages of samples. */
+#define SAMPLE_PAGES 32
+
+/* Number of most frequently hit addresses to print. */
+#define TOP_CNT 25
+
+/* One sample. */
+struct sample
+  {
+    uint32_t eip;               /* Interrupted instruction. */
+    char name[12];              /* User program, or "" in the kernel. */
+  };
+
+/* An address that was hit, and how often. */
+struct hit
+  {
+    const struct sample *sample; /* One of the samples. */
+    int cnt;                    /* Number of samples. */
+  };
+
+/* Sample buffer, null if profiling is off. */
+static struct sample *samples;
+static size_t sample_max;       /* Capacity of SAMPLES. */
+static size_t sample_cnt;       /* Number of samples in SAMPLES. */
+static int ticks_per_sample;    /* Timer ticks per sample. */
+static bool sampling;           /* False once printing starts. */
+static struct spinlock samples_lock;
+
+/* Statistics. */
+static long long kernel_cnt;    /* # of samples in the kernel. */
+static long long user_cnt;      /* # of samples in user programs. */
+static long long idle_cnt;      /* # of samples in idle threads. */
+static long long dropped_cnt;   /* # of samples that did not fit. */
+
+/* Ticks since each CPU last took a sample. */
+static int ticks_since[CPU_MAX];
+
+static int compare_samples (const void *, const void *);
+static int compare_hits (const void *, const void *);
+
+/* Turns on profiling, taking a sample every DIVISOR timer ticks
+   on each CPU.  Must be called after the page allocator is
+   initialized and before interrupts are turned on. */
+void
+profile_init (int divisor) 
+{
+  ASSERT (divisor > 0);
+
+  spinlock_init (&samples_lock);
+  samples = palloc_get_multiple (PAL_ASSERT, SAMPLE_PAGES);
+  sample_max = SAMPLE_PAGES * PGSIZE / sizeof *samples;
+  ticks_per_sample = divisor;
+  sampling = true;
+}
+
+/* Called by the timer interrupt handlers with the interrupted
+   context F.  Records a sample every DIVISOR'th call on each
+   CPU. */
+void
+profile_sample (const struct intr_frame *f) 
+{
+  struct cpu *c;
+  struct thread *t;
+
+  if (!sampling)
+    return;
+  c = cpu_current ();
+  if (++ticks_since[c->id] < ticks_per_sample)
+    return;
+  ticks_since[c->id] = 0;
+  t = thread_current ();
+
+  spinlock_acquire (&samples_lock);
+  if (t == c->idle_thread)
+    idle_cnt++;
+  else if (sample_cnt >= sample_max)
+    dropped_cnt++;
+  else 
+    {
+      struct sample *s = &samples[sample_cnt++];
+      s->eip = (uint32_t) f->eip;
+      if ((f->cs & 3) == 3) 
+        {
+          strlcpy (s->name, t->name, sizeof s->name);
+          user_cnt++;
+        }
+      else 
+        {
+          s->name[0] = '\0';
+          kernel_cnt++;
+        }
+    }
+  spinlock_release (&samples_lock);
+}
+
+/* Stops profiling and prints a flat profile: the addresses hit
+   by the most samples. */
+void
+profile_print_stats (void) 
+{
+  struct hit *hits;
+  size_t hit_cnt;
+  long long total;
+  enum intr_level old_level;
+  size_t i;
+
+  if (samples == NULL)
+    return;
+
+  old_level = intr_disable ();
+  spinlock_acquire (&samples_lock);
+  sampling = false;
+  spinlock_release (&samples_lock);
+  intr_set_level (old_level);
+
+  total = kernel_cnt + user_cnt + idle_cnt + dropped_cnt;
+  printf ("Profile: %lld samples, 1 every %d ticks: %lld kernel, "
+          "%lld user, %lld idle, %lld dropped\n",
+          total, ticks_per_sample, kernel_cnt, user_cnt, idle_cnt, dropped_cnt);
+  if (sample_cnt == 0)
+    return;
+
+  /* Count the samples at each address. */
+  qsort (samples, sample_cnt, sizeof *samples, compare_samples);
+  hits = malloc (sample_cnt * sizeof *hits);
+  if (hits == NULL) 
+    {
+      printf ("Profile: out of memory\n");
+      return;
+    }
+  hit_cnt = 0;
+  for (i = 0; i < sample_cnt; i++)
+    if (hit_cnt > 0
+        && !compare_samples (hits[hit_cnt - 1].sample, &samples[i]))
+      hits[hit_cnt - 1].cnt++;
+    else 
+      {
+        hits[hit_cnt].sample = &samples[i];
+        hits[hit_cnt].cnt = 1;
+        hit_cnt++;
+      }
+  qsort (hits, hit_cnt, sizeof *hits, compare_hits);
+
+  printf ("Profile: %8s %6s  %s\n", "samples", "%", "address");
+  for (i = 0; i < hit_cnt && i < TOP_CNT; i++) 
+    {
+      const struct sample *s = hits[i].sample;
+      int permille = hits[i].cnt * 1000LL / total;
+      printf ("Profile: %8d %3d.%d%%  %s 0x%08"PRIx32"\n",
+              hits[i].cnt, permille / 10, permille % 10,
+              s->name[0] != '\0' ? s->name : "kernel", s->eip);
+    }
+  printf ("Profile: use `backtrace kernel.o ADDRESS...' or "
+          "`backtrace PROGRAM ADDRESS...' for function names.\n");
+  free (hits);
+}
+
+/* Orders samples by program, with the kernel first, then by
+   address. */
+static int
+compare_samples (const void *a_, const void *b_) 
+{
+  const struct sample *a = a_;
+  const struct sample *b = b_;
+  int cmp = strcmp (a->name, b->name);
+
+  if (cmp != 0)
+    return cmp;
+  return a->eip < b->eip ? -1 : a->eip > b->eip;
+}
+
+/* Orders hits from most to least frequent. */
+static int
+compare_hits (const void *a_, const void *b_) 
+{
+  const struct hit *a = a_;
+  const struct hit *b = b_;
+
+  return b->cnt - a->cnt;
+}
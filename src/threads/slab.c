@@ -0,0 +1,268 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Object caches, after Bonwick's slab allocator for SunOS.
+
+   A cache hands out objects of one type, and so of one size.  It
+   gets them from "slabs", single pages that it divides into as
+   many objects as fit behind a small header.  Unlike malloc(),
+   which rounds every request up to a power of 2, a cache wastes
+   at most the leftover at the end of each page.
+
+   The header of each slab keeps a stack of the indexes of its
+   free objects, so that the objects themselves are never written
+   by the cache.  That makes constructors possible: a cache with a
+   constructor runs it on each object once, when the object's slab
+   is created, and from then on the object's user must give each
+   object back in its constructed state, for instance with its
+   locks released and its lists empty.  Allocating from such a
+   cache then skips that initialization altogether.
+
+   Each cache keeps the slabs that have a free object on a list,
+   so allocation and freeing take constant time.  A slab whose
+   objects are all free goes back to the page allocator, except
+   for one per cache, which is kept to keep a single object being
+   allocated and freed over and over from costing a page each
+   time. */
+
+/* Maximum number of caches. */
+#define CACHE_MAX 16
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* An object cache. */
+struct kmem_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Size of each object, rounded up. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    size_t obj_ofs;             /* Offset of the first object in a slab. */
+    kmem_ctor *ctor;            /* Constructor, or null. */
+    struct lock lock;           /* Protects all of the below. */
+    struct list slabs;          /* Slabs with at least one free object. */
+    size_t empty_cnt;           /* Slabs with no objects in use. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Number of slabs. */
+    size_t in_use;              /* Number of objects in use. */
+    size_t peak_in_use;         /* Highest value of IN_USE. */
+    unsigned long long alloc_cnt; /* Number of allocations. */
+  };
+
+/* A slab: the header at the start of each slab's page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* In cache's `slabs', unless full. */
+    size_t free_cnt;            /* Number of free objects. */
+    uint16_t free_idx[];        /* Indexes of the free objects. */
+  };
+
+/* Our set of caches. */
+static struct kmem_cache caches[CACHE_MAX];
+static size_t cache_cnt;
+
+static struct slab *new_slab (struct kmem_cache *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+static void *slab_obj (struct kmem_cache *, struct slab *, size_t idx);
+
+/* Creates and returns a cache for objects of SIZE bytes, named
+   NAME, whose objects are initialized by CTOR, if it is
+   nonnull.  SIZE must be small enough that a page holds at least
+   one object.  Does not allocate memory, so it may be called
+   before the page allocator is initialized. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor *ctor) 
+{
+  struct kmem_cache *c;
+  size_t n;
+
+  ASSERT (size > 0);
+  if (cache_cnt >= CACHE_MAX)
+    PANIC ("kmem_cache_create: too many caches");
+  c = &caches[cache_cnt++];
+
+  c->name = name;
+  c->obj_size = ROUND_UP (size, sizeof (void *));
+  c->ctor = ctor;
+
+  /* Fit as many objects as we can behind the header and its
+     stack of free object indexes. */
+  n = (PGSIZE - sizeof (struct slab)) / (c->obj_size + sizeof (uint16_t));
+  while (n > 0
+         && (ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                       sizeof (void *))
+             + n * c->obj_size) > PGSIZE)
+    n--;
+  ASSERT (n > 0);
+  c->objs_per_slab = n;
+  c->obj_ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                         sizeof (void *));
+
+  lock_init_named (&c->lock, "slab");
+  list_init (&c->slabs);
+  c->empty_cnt = 0;
+  c->slab_cnt = c->in_use = c->peak_in_use = 0;
+  c->alloc_cnt = 0;
+  return c;
+}
+
+/* Obtains and returns an object from cache C, constructed if C
+   has a constructor and otherwise with undefined contents.
+   Returns a null pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) 
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+  if (list_empty (&c->slabs)) 
+    {
+      /* Construct the new slab without holding the lock. */
+      lock_release (&c->lock);
+      s = new_slab (c);
+      if (s == NULL)
+        return NULL;
+      lock_acquire (&c->lock);
+      list_push_front (&c->slabs, &s->elem);
+      c->slab_cnt++;
+      c->empty_cnt++;
+    }
+
+  s = list_entry (list_front (&c->slabs), struct slab, elem);
+  if (s->free_cnt == c->objs_per_slab)
+    c->empty_cnt--;
+  obj = slab_obj (c, s, s->free_idx[--s->free_cnt]);
+  if (s->free_cnt == 0)
+    list_remove (&s->elem);
+
+  c->alloc_cnt++;
+  if (++c->in_use > c->peak_in_use)
+    c->peak_in_use = c->in_use;
+  lock_release (&c->lock);
+  return obj;
+}
+
+/* Gives OBJ, which must have been obtained from cache C, back to
+   C.  If C has a constructor, OBJ must be in its constructed
+   state. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) 
+{
+  struct slab *s;
+  bool free_slab = false;
+
+  if (obj == NULL)
+    return;
+  s = obj_to_slab (c, obj);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it has to stay constructed. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+  ASSERT (s->free_cnt < c->objs_per_slab);
+  s->free_idx[s->free_cnt++] = ((uint8_t *) obj - ((uint8_t *) s + c->obj_ofs))
+                               / c->obj_size;
+  if (s->free_cnt == 1)
+    list_push_front (&c->slabs, &s->elem);
+  if (s->free_cnt == c->objs_per_slab) 
+    {
+      /* Keep one empty slab, give back the rest. */
+      if (c->empty_cnt > 0) 
+        {
+          list_remove (&s->elem);
+          c->slab_cnt--;
+          free_slab = true;
+        }
+      else
+        c->empty_cnt++;
+    }
+  c->in_use--;
+  lock_release (&c->lock);
+
+  if (free_slab)
+    palloc_free_page (s);
+}
+
+/* Prints statistics for each cache. */
+void
+kmem_cache_print_stats (void) 
+{
+  size_t i;
+
+  for (i = 0; i < cache_cnt; i++) 
+    {
+      struct kmem_cache *c = &caches[i];
+
+      printf ("Slab: %s: %zu-byte objects, %zu per slab, %zu slabs, "
+              "%zu in use (peak %zu), %llu allocations\n",
+              c->name, c->obj_size, c->objs_per_slab, c->slab_cnt,
+              c->in_use, c->peak_in_use, c->alloc_cnt);
+    }
+}
+
+/* Allocates a new slab for cache C, with all of its objects free
+   and constructed.  Returns a null pointer if memory is not
+   available. */
+static struct slab *
+new_slab (struct kmem_cache *c) 
+{
+  struct slab *s = palloc_get_page (PAL_SLAB);
+  size_t i;
+
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->objs_per_slab;
+
+  /* Hand out the objects in address order. */
+  for (i = 0; i < c->objs_per_slab; i++) 
+    {
+      s->free_idx[i] = c->objs_per_slab - 1 - i;
+      if (c->ctor != NULL)
+        c->ctor (slab_obj (c, s, i));
+    }
+  return s;
+}
+
+/* Returns the slab that OBJ, from cache C, is in. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj) 
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT (pg_ofs (obj) >= c->obj_ofs);
+  ASSERT ((pg_ofs (obj) - c->obj_ofs) % c->obj_size == 0);
+
+  return s;
+}
+
+/* Returns the IDX'th object in slab S of cache C. */
+static void *
+slab_obj (struct kmem_cache *c, struct slab *s, size_t idx) 
+{
+  ASSERT (idx < c->objs_per_slab);
+  return (uint8_t *) s + c->obj_ofs + idx * c->obj_size;
+}
@@ -0,0 +1,85 @@
+#include "threads/spinlock.h"
+#include <debug.h>
+#include <stddef.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+
+/* Atomically stores VALUE in *P and returns the previous
+   contents of *P.  See [IA32-v2b] "XCHG"; XCHG with a memory
+   operand is always locked. */
+static inline int
+xchg (volatile int *p, int value)
+{
+  asm volatile ("xchgl %0, %1" : "+m" (*p), "+r" (value) : : "memory");
+  return value;
+}
+
+/* Initializes LOCK as not held. */
+void
+spinlock_init (struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+
+  lock->locked = 0;
+  lock->cpu = NULL;
+}
+
+/* Acquires LOCK, spinning until it becomes available.
+   Interrupts must be off, and the current CPU must not already
+   hold LOCK. */
+void
+spinlock_acquire (struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!spinlock_held_by_current_cpu (lock));
+
+  while (xchg (&lock->locked, 1) != 0)
+    {
+      /* Spin on a plain read, so that the waiting CPUs do not
+         keep taking the cache line away from the holder.  PAUSE
+         tells the CPU we are in a spin-wait loop; see
+         [IA32-v2b] "PAUSE". */
+      while (lock->locked)
+        asm volatile ("pause" : : : "memory");
+    }
+  lock->cpu = cpu_current ();
+}
+
+/* Tries to acquire LOCK without spinning and returns true if
+   successful, false if another CPU holds it.  Interrupts must
+   be off. */
+bool
+spinlock_try_acquire (struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!spinlock_held_by_current_cpu (lock));
+
+  if (xchg (&lock->locked, 1) != 0)
+    return false;
+  lock->cpu = cpu_current ();
+  return true;
+}
+
+/* Releases LOCK, which the current CPU must hold.  The lock
+   need not be released by the thread that acquired it, as long
+   as both run on the same CPU; schedule() relies on this. */
+void
+spinlock_release (struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+  ASSERT (spinlock_held_by_current_cpu (lock));
+
+  lock->cpu = NULL;
+  xchg (&lock->locked, 0);
+}
+
+/* Returns true if the current CPU holds LOCK, false otherwise. */
+bool
+spinlock_held_by_current_cpu (const struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+
+  return lock->locked && lock->cpu == cpu_current ();
+}
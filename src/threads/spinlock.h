@@ -0,0 +1,27 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <stdbool.h>
+
+/* A spinlock.  Protects data shared between CPUs for short
+   stretches of code that must not sleep, such as the run queues
+   and the waiter lists inside semaphores.
+
+   Disabling interrupts only keeps other code on the same CPU
+   out; a spinlock keeps the other CPUs out as well.  Interrupts
+   must be off for as long as a spinlock is held, so that an
+   interrupt handler on the same CPU cannot try to take it
+   again.  Spinlocks are not recursive. */
+struct spinlock
+  {
+    volatile int locked;        /* Nonzero while held. */
+    struct cpu *cpu;            /* CPU holding the lock (for debugging). */
+  };
+
+void spinlock_init (struct spinlock *);
+void spinlock_acquire (struct spinlock *);
+bool spinlock_try_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *);
+bool spinlock_held_by_current_cpu (const struct spinlock *);
+
+#endif /* threads/spinlock.h */
@@ -27,8 +27,10 @@
 */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
@@ -48,6 +50,7 @@ sema_init (struct semaphore *sema, unsigned value)
 
   sema->value = value;
   list_init (&sema->waiters);
+  spinlock_init (&sema->lock);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -66,15 +69,66 @@ sema_down (struct semaphore *sema)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
+  spinlock_acquire (&sema->lock);
   while (sema->value == 0) 
     {
-      list_push_back (&sema->waiters, &thread_current ()->elem);
-      thread_block ();
+      list_push_back (&sema->waiters, &thread_current ()->wait_elem);
+      thread_block_release (&sema->lock);
+      spinlock_acquire (&sema->lock);
     }
   sema->value--;
+  spinlock_release (&sema->lock);
   intr_set_level (old_level);
 }
 
+/* Down or "P" operation on a semaphore that gives up after
+   TIMEOUT timer ticks.  Returns true if SEMA was decremented,
+   false if the time ran out first.  With a TIMEOUT of zero or
+   less, this is sema_try_down().
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+sema_down_timeout (struct semaphore *sema, int64_t timeout) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int64_t deadline;
+  bool success = true;
+
+  ASSERT (sema != NULL);
+  ASSERT (!intr_context ());
+
+  if (timeout <= 0)
+    return sema_try_down (sema);
+
+  old_level = intr_disable ();
+  deadline = timer_ticks () + timeout;
+  spinlock_acquire (&sema->lock);
+  while (sema->value == 0) 
+    {
+      list_push_back (&sema->waiters, &cur->wait_elem);
+      if (timer_block_release (&sema->lock, deadline)) 
+        spinlock_acquire (&sema->lock);
+      else
+        {
+          spinlock_acquire (&sema->lock);
+          if (timer_wait_finish ())
+            list_remove (&cur->wait_elem);
+
+          /* An up that came in since is still ours. */
+          success = sema->value > 0;
+          break;
+        }
+    }
+  if (success)
+    sema->value--;
+  spinlock_release (&sema->lock);
+  intr_set_level (old_level);
+
+  return success;
+}
+
 /* Down or "P" operation on a semaphore, but only if the
    semaphore is not already 0.  Returns true if the semaphore is
    decremented, false otherwise.
@@ -89,6 +143,7 @@ sema_try_down (struct semaphore *sema)
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
+  spinlock_acquire (&sema->lock);
   if (sema->value > 0) 
     {
       sema->value--;
@@ -96,6 +151,7 @@ sema_try_down (struct semaphore *sema)
     }
   else
     success = false;
+  spinlock_release (&sema->lock);
   intr_set_level (old_level);
 
   return success;
@@ -113,10 +169,13 @@ sema_up (struct semaphore *sema)
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters)) 
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+  spinlock_acquire (&sema->lock);
+  while (!list_empty (&sema->waiters)) 
+    if (timer_wakeup (list_entry (list_pop_front (&sema->waiters),
+                                  struct thread, wait_elem)))
+      break;
   sema->value++;
+  spinlock_release (&sema->lock);
   intr_set_level (old_level);
 }
 
@@ -157,6 +216,23 @@ sema_test_helper (void *sema_)
     }
 }
 
+#ifdef LOCK_PROFILE
+/* Profiles of all named locks that have been initialized, and a
+   spinlock protecting the list.  The list is initialized along
+   with the first named lock. */
+static struct list profile_list;
+static bool profile_list_ready;
+static struct spinlock profile_list_lock;
+
+static bool acquire_profiled (struct lock *, int64_t timeout);
+static void profile_acquired (struct lock *, bool contended,
+                              uint64_t wait_start);
+static void profile_released (struct lock *);
+#else
+#define profile_acquired(LOCK, CONTENDED, WAIT_START) ((void) 0)
+#define profile_released(LOCK) ((void) 0)
+#endif
+
 /* Initializes LOCK.  A lock can be held by at most a single
    thread at any given time.  Our locks are not "recursive", that
    is, it is an error for the thread currently holding a lock to
@@ -179,6 +255,9 @@ lock_init (struct lock *lock)
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+#ifdef LOCK_PROFILE
+  lock->profile = NULL;
+#endif
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -196,10 +275,40 @@ lock_acquire (struct lock *lock)
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+#ifdef LOCK_PROFILE
+  if (lock->profile != NULL) 
+    {
+      acquire_profiled (lock, -1);
+      return;
+    }
+#endif
   sema_down (&lock->semaphore);
   lock->holder = thread_current ();
 }
 
+/* Like lock_acquire(), but gives up after TIMEOUT timer ticks.
+   Returns true if LOCK was acquired, false if the time ran out
+   first.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+lock_acquire_timeout (struct lock *lock, int64_t timeout)
+{
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!lock_held_by_current_thread (lock));
+
+#ifdef LOCK_PROFILE
+  if (lock->profile != NULL)
+    return acquire_profiled (lock, timeout > 0 ? timeout : 0);
+#endif
+  if (!sema_down_timeout (&lock->semaphore, timeout))
+    return false;
+  lock->holder = thread_current ();
+  return true;
+}
+
 /* Tries to acquires LOCK and returns true if successful or false
    on failure.  The lock must not already be held by the current
    thread.
@@ -215,8 +324,11 @@ lock_try_acquire (struct lock *lock)
   ASSERT (!lock_held_by_current_thread (lock));
 
   success = sema_try_down (&lock->semaphore);
-  if (success)
-    lock->holder = thread_current ();
+  if (success) 
+    {
+      lock->holder = thread_current ();
+      profile_acquired (lock, false, 0);
+    }
   return success;
 }
 
@@ -231,6 +343,7 @@ lock_release (struct lock *lock)
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  profile_released (lock);
   lock->holder = NULL;
   sema_up (&lock->semaphore);
 }
@@ -246,6 +359,163 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+#ifdef LOCK_PROFILE
+/* Makes LOCK count its contention in PROFILE, putting PROFILE on
+   the list that lock_print_profile() reports from if it is not
+   there yet.  Use lock_init_named() instead of calling this
+   directly. */
+void
+lock_set_profile (struct lock *lock, struct lock_profile *profile) 
+{
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+  ASSERT (profile != NULL && profile->name != NULL);
+
+  old_level = intr_disable ();
+  spinlock_acquire (&profile_list_lock);
+  if (!profile_list_ready) 
+    {
+      list_init (&profile_list);
+      profile_list_ready = true;
+    }
+  if (!profile->registered) 
+    {
+      spinlock_init (&profile->lock);
+      list_push_back (&profile_list, &profile->elem);
+      profile->registered = true;
+    }
+  spinlock_release (&profile_list_lock);
+  intr_set_level (old_level);
+
+  lock->profile = profile;
+}
+
+/* Acquires LOCK, which has a profile, and counts the
+   acquisition.  Waits for LOCK like lock_acquire() if TIMEOUT is
+   negative, otherwise like lock_acquire_timeout().  Returns true
+   if LOCK was acquired. */
+static bool
+acquire_profiled (struct lock *lock, int64_t timeout) 
+{
+  uint64_t wait_start = 0;
+  bool contended = false;
+
+  if (!sema_try_down (&lock->semaphore)) 
+    {
+      contended = true;
+      wait_start = timer_cycles ();
+      if (timeout < 0)
+        sema_down (&lock->semaphore);
+      else if (!sema_down_timeout (&lock->semaphore, timeout))
+        return false;
+    }
+  lock->holder = thread_current ();
+  profile_acquired (lock, contended, wait_start);
+  return true;
+}
+
+/* Records that the current thread just acquired LOCK, after
+   waiting for it since WAIT_START if CONTENDED. */
+static void
+profile_acquired (struct lock *lock, bool contended, uint64_t wait_start) 
+{
+  struct lock_profile *p = lock->profile;
+  enum intr_level old_level;
+  uint64_t now;
+
+  if (p == NULL)
+    return;
+
+  now = timer_cycles ();
+  lock->acquired_at = now;
+  old_level = intr_disable ();
+  spinlock_acquire (&p->lock);
+  p->acquires++;
+  if (contended) 
+    {
+      p->contended++;
+      p->wait_cycles += now - wait_start;
+    }
+  spinlock_release (&p->lock);
+  intr_set_level (old_level);
+}
+
+/* Records that the current thread is about to release LOCK. */
+static void
+profile_released (struct lock *lock) 
+{
+  struct lock_profile *p = lock->profile;
+  enum intr_level old_level;
+  uint64_t held;
+
+  if (p == NULL)
+    return;
+
+  held = timer_cycles () - lock->acquired_at;
+  old_level = intr_disable ();
+  spinlock_acquire (&p->lock);
+  if (held > p->max_hold_cycles)
+    p->max_hold_cycles = held;
+  spinlock_release (&p->lock);
+  intr_set_level (old_level);
+}
+
+/* Returns true if lock profile A_ was contended more often than
+   B_. */
+static bool
+more_contended (const struct list_elem *a_, const struct list_elem *b_,
+                void *aux UNUSED) 
+{
+  const struct lock_profile *a = list_entry (a_, struct lock_profile, elem);
+  const struct lock_profile *b = list_entry (b_, struct lock_profile, elem);
+
+  return a->contended > b->contended;
+}
+
+/* Prints the N most contended named locks. */
+void
+lock_print_profile (int n) 
+{
+  struct list_elem *e;
+  enum intr_level old_level;
+
+  if (!profile_list_ready) 
+    {
+      printf ("Locks: no named locks.\n");
+      return;
+    }
+
+  old_level = intr_disable ();
+  spinlock_acquire (&profile_list_lock);
+  list_sort (&profile_list, more_contended, NULL);
+  spinlock_release (&profile_list_lock);
+  intr_set_level (old_level);
+
+  /* No more locks get registered this late, so the list can be
+     walked without its lock, which printf() may not be called
+     under. */
+  printf ("Locks: %-16s %10s %10s %12s %12s\n",
+          "name", "acquires", "contended", "wait (us)", "max hold (us)");
+  for (e = list_begin (&profile_list);
+       e != list_end (&profile_list) && n-- > 0; e = list_next (e)) 
+    {
+      struct lock_profile *p = list_entry (e, struct lock_profile, elem);
+      printf ("Locks: %-16s %10lld %10lld %12"PRId64" %12"PRId64"\n",
+              p->name, p->acquires, p->contended,
+              timer_cycles_to_ns (p->wait_cycles) / 1000,
+              timer_cycles_to_ns (p->max_hold_cycles) / 1000);
+    }
+}
+#else /* !LOCK_PROFILE */
+/* Prints a reminder that lock profiling is compiled out. */
+void
+lock_print_profile (int n UNUSED) 
+{
+  printf ("Locks: not profiled; build with `make LOCK_PROFILE=1'.\n");
+}
+#endif /* !LOCK_PROFILE */
+
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
@@ -301,6 +571,43 @@ cond_wait (struct condition *cond, struct lock *lock)
   lock_acquire (lock);
 }
 
+/* Like cond_wait(), but gives up waiting after TIMEOUT timer
+   ticks.  LOCK is reacquired before returning either way.
+   Returns true if COND was signaled, false if the time ran out
+   first.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+cond_wait_timeout (struct condition *cond, struct lock *lock,
+                   int64_t timeout) 
+{
+  struct semaphore_elem waiter;
+  bool signaled;
+
+  ASSERT (cond != NULL);
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (lock_held_by_current_thread (lock));
+  
+  sema_init (&waiter.semaphore, 0);
+  list_push_back (&cond->waiters, &waiter.elem);
+  lock_release (lock);
+  signaled = sema_down_timeout (&waiter.semaphore, timeout);
+  lock_acquire (lock);
+
+  /* cond_signal() takes WAITER off the list and ups it in one
+     step under LOCK, so a signal that raced with the timeout
+     shows up in the semaphore. */
+  if (!signaled) 
+    {
+      signaled = sema_try_down (&waiter.semaphore);
+      if (!signaled)
+        list_remove (&waiter.elem);
+    }
+  return signaled;
+}
+
 /* If any threads are waiting on COND (protected by LOCK), then
    this function signals one of them to wake up from its wait.
    LOCK must be held before calling this function.
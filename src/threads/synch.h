@@ -3,29 +3,72 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "threads/spinlock.h"
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
     struct list waiters;        /* List of waiting threads. */
+    struct spinlock lock;       /* Protects the members above. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
 void sema_down (struct semaphore *);
+bool sema_down_timeout (struct semaphore *, int64_t timeout);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
+/* Contention statistics for a named lock, or for a whole class
+   of locks initialized at the same place, such as the locks in
+   every inode.  Only built with -DLOCK_PROFILE. */
+struct lock_profile 
+  {
+    const char *name;           /* Name, for lock_print_profile(). */
+    bool registered;            /* On the list of profiled locks? */
+    struct list_elem elem;      /* List element. */
+    struct spinlock lock;       /* Protects the counters below. */
+    long long acquires;         /* # of acquisitions. */
+    long long contended;        /* # of those that had to wait. */
+    uint64_t wait_cycles;       /* Total time spent waiting. */
+    uint64_t max_hold_cycles;   /* Longest time held. */
+  };
+
 /* Lock. */
 struct lock 
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+#ifdef LOCK_PROFILE
+    struct lock_profile *profile; /* Statistics, or null if unnamed. */
+    uint64_t acquired_at;       /* When the holder acquired it. */
+#endif
   };
 
 void lock_init (struct lock *);
+
+/* Initializes LOCK like lock_init() and, in kernels built with
+   -DLOCK_PROFILE, collects its contention statistics under NAME.
+   Every lock initialized by the same call shares one set of
+   statistics.  Otherwise this is just lock_init(). */
+#ifdef LOCK_PROFILE
+#define lock_init_named(LOCK, NAME)                                     \
+        do                                                              \
+          {                                                             \
+            static struct lock_profile lock_profile_ = { .name = NAME }; \
+            lock_init (LOCK);                                           \
+            lock_set_profile (LOCK, &lock_profile_);                    \
+          }                                                             \
+        while (0)
+void lock_set_profile (struct lock *, struct lock_profile *);
+#else
+#define lock_init_named(LOCK, NAME) lock_init (LOCK)
+#endif
+void lock_print_profile (int n);
 void lock_acquire (struct lock *);
+bool lock_acquire_timeout (struct lock *, int64_t timeout);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
@@ -38,6 +81,7 @@ struct condition
 
 void cond_init (struct condition *);
 void cond_wait (struct condition *, struct lock *);
+bool cond_wait_timeout (struct condition *, struct lock *, int64_t timeout);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
@@ -17,7 +17,8 @@
 
 #include "copyright.h"
 #include "synchlist.h"
-#include "threads/malloc.h"
+#include <debug.h>
+#include "devices/timer.h"
 
 //----------------------------------------------------------------------
 // SynchList::SynchList
@@ -36,63 +37,146 @@ void sl_init(struct SynchList *sl)
 
 //----------------------------------------------------------------------
 // SynchList::~SynchList
-//	Remove and de-allocate all elements of the synchronized list
+//	Drop all elements of the synchronized list.  The items
+//	belong to the caller, so nothing is freed here.
 //----------------------------------------------------------------------
 
 void sl_destroy(struct SynchList *sl)
 {
-  struct list_elem *e;
-  struct SL_element *sl_elem;
-  while(!list_empty(&sl->sl_list)){
-    e = list_pop_front(&sl->sl_list);
-    sl_elem = list_entry(e, struct SL_element, elem);
-    free(sl_elem);
-  }
+  list_init(&sl->sl_list);
 }
 
 
 //----------------------------------------------------------------------
 // SynchList::Append
-//      Append an "item" to the end of the list.  Wake up anyone
+//      Append an element to the end of the list.  Wake up anyone
 //	waiting for an element to be appended.
 //
-//	"item" is the thing to put on the list, it can be a pointer to 
-//		anything.
+//	"elem" is the list_elem embedded in the item to put on the
+//		list.
 //----------------------------------------------------------------------
 
-void sl_append(struct SynchList *sl, void *item)
+void sl_append(struct SynchList *sl, struct list_elem *elem)
 {
   lock_acquire(&sl->sl_lock);                // enforce mutual exclusive access to the list 
-  struct SL_element *sl_elem = malloc(sizeof(struct SL_element));
-  sl_elem->item = item;
-  list_push_back(&sl->sl_list, &sl_elem->elem);
+  list_push_back(&sl->sl_list, elem);
   cond_signal(&sl->sl_empty,&sl->sl_lock);  // wake up a waiter, if any
   lock_release(&sl->sl_lock);              
-  return;
+}
+
+
+//----------------------------------------------------------------------
+// SynchList::AppendBatch
+//      Move all the elements of "elems" to the end of the list, in
+//	order, with one lock round trip.  "elems" is left empty.
+//	Wake up one waiter for a single element, everyone for more.
+//----------------------------------------------------------------------
+
+void sl_append_batch(struct SynchList *sl, struct list *elems)
+{
+  bool many;
+
+  if(list_empty(elems))
+    return;
+  many = list_front(elems) != list_back(elems);
+
+  lock_acquire(&sl->sl_lock);
+  list_splice(list_end(&sl->sl_list), list_begin(elems), list_end(elems));
+  if(many)
+    cond_broadcast(&sl->sl_empty, &sl->sl_lock);
+  else
+    cond_signal(&sl->sl_empty, &sl->sl_lock);
+  lock_release(&sl->sl_lock);
 }
 
 
 //----------------------------------------------------------------------
 // SynchList::Remove
-//      Remove an "item" from the beginning of the list.  Wait if
+//      Remove an element from the beginning of the list.  Wait if
 //	the list is empty.
 // Returns:
-//	The removed item. 
+//	The removed element. 
 //----------------------------------------------------------------------
 
-void *sl_remove(struct SynchList *sl)
+struct list_elem *sl_remove(struct SynchList *sl)
 {
   struct list_elem *e;
-  void *item;
   lock_acquire(&sl->sl_lock);                // enforce mutual exclusion
   while(list_empty(&sl->sl_list)){
     cond_wait(&sl->sl_empty, &sl->sl_lock);  // wait until list isn't empty
   }
   e = list_pop_front(&sl->sl_list);
-  struct SL_element *sl_elem = list_entry(e, struct SL_element, elem);
-  item = sl_elem->item;
-  free(sl_elem);
   lock_release(&sl->sl_lock);
-  return item;
+  return e;
+}
+
+
+//----------------------------------------------------------------------
+// SynchList::TryRemove
+//      Remove an element from the beginning of the list, without
+//	waiting.
+// Returns:
+//	The removed element, or NULL if the list was empty.
+//----------------------------------------------------------------------
+
+struct list_elem *sl_try_remove(struct SynchList *sl)
+{
+  struct list_elem *e = NULL;
+  lock_acquire(&sl->sl_lock);
+  if(!list_empty(&sl->sl_list))
+    e = list_pop_front(&sl->sl_list);
+  lock_release(&sl->sl_lock);
+  return e;
 }
 
+
+//----------------------------------------------------------------------
+// SynchList::RemoveTimeout
+//      Remove an element from the beginning of the list.  Wait at
+//	most "timeout" timer ticks in all for the list to become
+//	non-empty.
+// Returns:
+//	The removed element, or NULL if the time ran out.
+//----------------------------------------------------------------------
+
+struct list_elem *sl_remove_timeout(struct SynchList *sl, int64_t timeout)
+{
+  struct list_elem *e = NULL;
+  int64_t deadline = timer_ticks() + timeout;
+  lock_acquire(&sl->sl_lock);
+  while(list_empty(&sl->sl_list)){
+    int64_t left = deadline - timer_ticks();
+    if(left <= 0 || !cond_wait_timeout(&sl->sl_empty, &sl->sl_lock, left))
+      break;
+  }
+  if(!list_empty(&sl->sl_list))
+    e = list_pop_front(&sl->sl_list);
+  lock_release(&sl->sl_lock);
+  return e;
+}
+
+
+//----------------------------------------------------------------------
+// SynchList::RemoveBatch
+//      Move up to "max" elements from the beginning of the list to
+//	the end of "elems", in order.  Wait if the list is empty, but
+//	not for more than the first element.
+// Returns:
+//	The number of elements removed, at least 1.
+//----------------------------------------------------------------------
+
+size_t sl_remove_batch(struct SynchList *sl, struct list *elems, size_t max)
+{
+  size_t cnt = 0;
+  ASSERT(max > 0);
+  lock_acquire(&sl->sl_lock);
+  while(list_empty(&sl->sl_list)){
+    cond_wait(&sl->sl_empty, &sl->sl_lock);
+  }
+  while(cnt < max && !list_empty(&sl->sl_list)){
+    list_push_back(elems, list_pop_front(&sl->sl_list));
+    cnt++;
+  }
+  lock_release(&sl->sl_lock);
+  return cnt;
+}
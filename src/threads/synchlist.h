@@ -13,6 +13,8 @@
 
 #include "copyright.h"
 #include <list.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "threads/synch.h"
 
 // The following class defines a "synchronized list" -- a list for which:
@@ -27,13 +29,16 @@ struct SynchList {
   struct condition sl_empty;
 };
 
-struct SL_element
-{
-  struct list_elem elem;
-  void *item;
-};
+// Items are intrusive: each one embeds a struct list_elem, which
+// is what goes on the list, so appending never allocates memory.
+// Use list_entry() to get from a removed element back to its item.
+// An element may be on only one list at a time.
 
 void sl_init(struct SynchList *sl);
 void sl_destroy(struct SynchList *sl);
-void sl_append(struct SynchList *sl, void *item);
-void *sl_remove(struct SynchList *sl);
+void sl_append(struct SynchList *sl, struct list_elem *elem);
+void sl_append_batch(struct SynchList *sl, struct list *elems);
+struct list_elem *sl_remove(struct SynchList *sl);
+struct list_elem *sl_try_remove(struct SynchList *sl);
+struct list_elem *sl_remove_timeout(struct SynchList *sl, int64_t timeout);
+size_t sl_remove_batch(struct SynchList *sl, struct list *elems, size_t max);
@@ -1,16 +1,20 @@
 #include "threads/thread.h"
 #include <debug.h>
 #include <stddef.h>
+#include <inttypes.h>
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/spinlock.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -20,12 +24,23 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Each CPU has its own run queue, the list of processes in
+   THREAD_READY state that are waiting to run on that CPU, and
+   its own idle thread.  See `struct cpu' in cpu.h.  A thread
+   that becomes ready goes back to the CPU it last ran on, so
+   that it finds its cache still warm; new threads are dealt out
+   to the CPUs in turn.
 
-/* Idle thread. */
-static struct thread *idle_thread;
+   A CPU that runs out of threads steals half of the longest
+   other run queue (see steal()), and an idle CPU is interrupted
+   to do so whenever a thread is queued behind others.
+
+   A CPU's run queue lock is held from the time the running
+   thread decides to give up the CPU until schedule_tail() has
+   finished switching to the next thread, so that no other CPU
+   can pick up the old thread while its registers are still
+   being saved.  Locks that protect wait queues, such as a
+   semaphore's, are always acquired before a run queue lock. */
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
@@ -41,14 +56,22 @@ struct kernel_thread_frame
     void *aux;                  /* Auxiliary data for function. */
   };
 
-/* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
+/* Statistics.  The rest are kept per CPU, in `struct cpu'. */
+static long long page_hits;     /* # of thread pages reused from cache. */
+
+/* Pages of threads that have died, kept for reuse by
+   thread_create() so that spawning does not have to zero a page
+   and go back to the page allocator.  Accessed only with
+   interrupts off and PAGE_CACHE_LOCK held. */
+#define PAGE_CACHE_SIZE 8
+static struct thread *page_cache[PAGE_CACHE_SIZE];
+static size_t page_cache_cnt;
+static struct spinlock page_cache_lock;
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+#define CACHE_HOT_NS 500000     /* A thread that ran on a CPU this
+                                   recently is not stolen from it. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
@@ -57,12 +80,20 @@ bool thread_mlfqs;
 
 static void kernel_thread (thread_func *, void *aux);
 
-static void idle (void *aux UNUSED);
+static void idle (void *aux);
 static struct thread *running_thread (void);
-static struct thread *next_thread_to_run (void);
+static struct cpu *choose_cpu (void);
+static void kick_idle_cpu (void);
+static struct cpu *find_victim (struct cpu *);
+static unsigned steal (struct cpu *);
+static struct thread *next_thread_to_run (struct cpu *);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
+static struct thread *alloc_thread_page (void);
+static void account_wait (struct cpu *, struct thread *, uint64_t now);
+static uint64_t *run_counter (struct cpu *, struct thread *);
+static void free_thread_page (struct thread *);
 static void schedule (void);
 void schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
@@ -73,7 +104,7 @@ static tid_t allocate_tid (void);
    because loader.S was careful to put the bottom of the stack at a
    page boundary.
 
-   Also initializes the run queue and the tid lock.
+   Also initializes the run queues and the tid lock.
 
    After calling this function, be sure to initialize the page
    allocator before trying to create any threads with
@@ -86,14 +117,17 @@ thread_init (void)
 {
   ASSERT (intr_get_level () == INTR_OFF);
 
+  cpu_init ();
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  spinlock_init (&page_cache_lock);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
+  initial_thread->cpu = &cpus[0];
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid ();
+  initial_thread->run_since = timer_cycles ();
 
   DEBUG_thread_init();
 }
@@ -116,11 +150,14 @@ init_thread (struct thread *t, const char *name, int priority)
   t->pid = -1;
 
   /* YES! You may want add stuff here. */
+#ifdef USERPROG
   map_init(&t->file_list);
+#endif
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
-   Also creates the idle thread. */
+   Also creates the bootstrap processor's idle thread.  The other
+   CPUs are started later, by cpu_start_aps(). */
 void
 thread_start (void) 
 {
@@ -132,7 +169,7 @@ thread_start (void)
   /* Start preemptive thread scheduling. */
   intr_enable ();
 
-  /* Wait for the idle thread to initialize idle_thread. */
+  /* Wait for the idle thread to initialize cpus[0].idle_thread. */
   sema_down (&idle_started);
 }
 
@@ -141,29 +178,105 @@ thread_start (void)
 void
 thread_tick (void) 
 {
+  struct cpu *c = cpu_current ();
   struct thread *t = thread_current ();
 
-  /* Update statistics. */
-  if (t == idle_thread)
-    idle_ticks++;
-#ifdef USERPROG
-  else if (t->pagedir != NULL)
-    user_ticks++;
-#endif
-  else
-    kernel_ticks++;
-
-  /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  /* Enforce preemption.  An idle CPU also goes looking for work
+     to steal, in case it missed being kicked. */
+  if (++c->thread_ticks >= TIME_SLICE
+      || (t == c->idle_thread && find_victim (c) != NULL))
     intr_yield_on_return ();
 }
 
-/* Prints thread statistics. */
+/* Prints thread statistics, totalled over all CPUs, followed by
+   a line per CPU if more than one was started.
+
+   Idle, kernel and user time is charged by schedule() when a
+   thread is switched out, so here the time the running thread
+   has had since it was switched in is added on, for this CPU,
+   and for the other CPUs if they are idle.  A CPU busy running
+   something else is a slice behind. */
 void
 thread_print_stats (void) 
 {
-  printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
-          idle_ticks, kernel_ticks, user_ticks);
+  uint64_t idle_cycles = 0, kernel_cycles = 0, user_cycles = 0;
+  uint64_t cpu_idle[CPU_MAX], cpu_kernel[CPU_MAX], cpu_user[CPU_MAX];
+  uint64_t now;
+  long long voluntary_switches = 0, involuntary_switches = 0;
+  long long steals = 0, migrations = 0;
+  static long long wait_hist[WAIT_HIST_BUCKETS];
+  uint64_t max_wait_cycles = 0;
+  unsigned online = 0;
+  unsigned i;
+
+  memset (wait_hist, 0, sizeof wait_hist);
+  now = timer_cycles ();
+  for (i = 0; i < cpu_cnt; i++) 
+    {
+      struct cpu *c = &cpus[i];
+      int j;
+
+      if (!c->online)
+        continue;
+      online++;
+      cpu_idle[i] = c->idle_cycles;
+      cpu_kernel[i] = c->kernel_cycles;
+      cpu_user[i] = c->user_cycles;
+      if (c == cpu_current () || c->idling) 
+        {
+          struct thread *t = c->idling ? c->idle_thread : thread_current ();
+          uint64_t *counter = run_counter (c, t);
+          uint64_t ran = now - t->run_since;
+
+          if (counter == &c->idle_cycles)
+            cpu_idle[i] += ran;
+          else if (counter == &c->user_cycles)
+            cpu_user[i] += ran;
+          else
+            cpu_kernel[i] += ran;
+        }
+      idle_cycles += cpu_idle[i];
+      kernel_cycles += cpu_kernel[i];
+      user_cycles += cpu_user[i];
+      voluntary_switches += c->voluntary_switches;
+      involuntary_switches += c->involuntary_switches;
+      steals += c->steals;
+      migrations += c->migrations;
+      if (c->max_wait_cycles > max_wait_cycles)
+        max_wait_cycles = c->max_wait_cycles;
+      for (j = 0; j < WAIT_HIST_BUCKETS; j++)
+        wait_hist[j] += c->wait_hist[j];
+    }
+
+  printf ("Thread: %"PRId64" us idle, %"PRId64" us in kernel threads, "
+          "%"PRId64" us in user programs, %lld cached pages reused\n",
+          timer_cycles_to_ns (idle_cycles) / 1000,
+          timer_cycles_to_ns (kernel_cycles) / 1000,
+          timer_cycles_to_ns (user_cycles) / 1000, page_hits);
+  printf ("Thread: %lld voluntary switches, %lld involuntary switches, "
+          "%"PRId64" us longest ready wait\n",
+          voluntary_switches, involuntary_switches,
+          timer_cycles_to_ns (max_wait_cycles) / 1000);
+  if (online > 1)
+    printf ("Thread: %lld steals, %lld migrations\n", steals, migrations);
+  for (i = 0; i < WAIT_HIST_BUCKETS; i++)
+    if (wait_hist[i] != 0)
+      printf ("Thread: ready wait < %"PRId64" ns: %lld\n",
+              timer_cycles_to_ns ((uint64_t) 2 << i), wait_hist[i]);
+
+  if (online > 1)
+    for (i = 0; i < cpu_cnt; i++) 
+      {
+        struct cpu *c = &cpus[i];
+        if (c->online)
+          printf ("Thread: cpu%u: %"PRId64" us idle, %"PRId64" us kernel, "
+                  "%"PRId64" us user, %lld switches, %lld steals\n",
+                  c->id, timer_cycles_to_ns (cpu_idle[i]) / 1000,
+                  timer_cycles_to_ns (cpu_kernel[i]) / 1000,
+                  timer_cycles_to_ns (cpu_user[i]) / 1000,
+                  c->voluntary_switches + c->involuntary_switches,
+                  c->steals);
+      }
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -195,12 +308,12 @@ thread_create (const char *name, int priority,
   
   ASSERT (function != NULL);
 
-  /* Allows to simulate a failure in palloc_get_page below. */
+  /* Allows to simulate a failure in alloc_thread_page below. */
   if (DEBUG_thread_create_simulate_fail())
     return TID_ERROR;
     
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = alloc_thread_page ();
   if (t == NULL)
     return TID_ERROR;
 
@@ -233,6 +346,49 @@ thread_create (const char *name, int priority,
   return tid;
 }
 
+/* Creates the idle thread for CPU C, which cpu_start_aps() is
+   about to start, and returns it, or a null pointer if memory
+   is short.  The thread does not go through the run queue: C
+   starts out running on its stack, in cpu_ap_main(), which
+   calls thread_start_ap(). */
+struct thread *
+thread_create_idle (struct cpu *c) 
+{
+  struct thread *t;
+
+  ASSERT (c != &cpus[0]);
+
+  t = alloc_thread_page ();
+  if (t == NULL)
+    return NULL;
+
+  init_thread (t, "idle", PRI_MIN);
+  snprintf (t->name, sizeof t->name, "idle%u", c->id);
+  t->tid = allocate_tid ();
+  t->cpu = c;
+  t->status = THREAD_RUNNING;
+  c->idle_thread = t;
+  return t;
+}
+
+/* Starts scheduling on an application processor, which must be
+   running its idle thread, with interrupts off.  Called by
+   cpu_ap_main() once the CPU is set up.  Never returns. */
+void
+thread_start_ap (void) 
+{
+  struct cpu *c = cpu_current ();
+  struct thread *t = thread_current ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t == c->idle_thread);
+
+  t->run_since = timer_cycles ();
+  c->online = true;
+  idle (NULL);
+  NOT_REACHED ();
+}
+
 /* Puts the current thread to sleep.  It will not be scheduled
    again until awoken by thread_unblock().
 
@@ -242,10 +398,38 @@ thread_create (const char *name, int priority,
 void
 thread_block (void) 
 {
+  thread_block_release (NULL);
+}
+
+/* Like thread_block(), but also releases LOCK, if it is not
+   null, once the current thread can no longer miss a
+   thread_unblock().  This lets the caller put the current thread
+   on a wait queue protected by LOCK and go to sleep without
+   another CPU waking it up in between. */
+void
+thread_block_release (struct spinlock *lock) 
+{
+  thread_block_release2 (lock, NULL);
+}
+
+/* Like thread_block_release(), but for a thread that is on two
+   wait queues at once, protected by LOCK1 and LOCK2, either of
+   which may be null. */
+void
+thread_block_release2 (struct spinlock *lock1, struct spinlock *lock2) 
+{
+  struct cpu *c;
+
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
 
+  c = cpu_current ();
+  spinlock_acquire (&c->rq_lock);
   thread_current ()->status = THREAD_BLOCKED;
+  if (lock1 != NULL)
+    spinlock_release (lock1);
+  if (lock2 != NULL)
+    spinlock_release (lock2);
   schedule ();
 }
 
@@ -256,18 +440,36 @@ thread_block (void)
    This function does not preempt the running thread.  This can
    be important: if the caller had disabled interrupts itself,
    it may expect that it can atomically unblock a thread and
-   update other data. */
+   update other data.
+
+   T goes on the run queue of the CPU it last ran on, or on the
+   next CPU in turn if it never ran.  If that is another CPU and
+   it had nothing to run, it is interrupted so that it picks T
+   up.  If T has to wait behind other threads, an idle CPU is
+   interrupted instead, to steal some of them. */
 void
 thread_unblock (struct thread *t) 
 {
   enum intr_level old_level;
+  struct cpu *c;
+  bool was_empty;
 
   ASSERT (is_thread (t));
 
   old_level = intr_disable ();
+  c = t->cpu != NULL ? t->cpu : choose_cpu ();
+  spinlock_acquire (&c->rq_lock);
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  was_empty = list_empty (&c->ready_list);
+  list_push_back (&c->ready_list, &t->elem);
+  c->ready_cnt++;
   t->status = THREAD_READY;
+  t->ready_since = timer_cycles ();
+  spinlock_release (&c->rq_lock);
+  if (was_empty)
+    cpu_kick (c);
+  else
+    kick_idle_cpu ();
   intr_set_level (old_level);
 }
 
@@ -319,6 +521,7 @@ thread_exit (void)
   /* Just set our status to dying and schedule another process.
      We will be destroyed during the call to schedule_tail(). */
   intr_disable ();
+  spinlock_acquire (&cpu_current ()->rq_lock);
   
   thread_current ()->status = THREAD_DYING;
   
@@ -333,17 +536,36 @@ thread_yield (void)
 {
   struct thread *cur = thread_current ();
   enum intr_level old_level;
+  struct cpu *c;
   
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (cur != idle_thread) 
-    list_push_back (&ready_list, &cur->elem);
+  c = cpu_current ();
+  spinlock_acquire (&c->rq_lock);
+  if (cur != c->idle_thread) 
+    {
+      list_push_back (&c->ready_list, &cur->elem);
+      c->ready_cnt++;
+    }
   cur->status = THREAD_READY;
+  cur->ready_since = timer_cycles ();
   schedule ();
   intr_set_level (old_level);
 }
 
+/* Yields the CPU on behalf of an interrupt handler that found
+   the running thread's time slice used up.  Same as
+   thread_yield(), but counted as an involuntary switch. */
+void
+thread_preempt (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  cpu_current ()->preempting = true;
+  thread_yield ();
+}
+
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void
 thread_set_priority (int new_priority) 
@@ -391,26 +613,69 @@ thread_get_recent_cpu (void)
 
 /* Idle thread.  Executes when no other thread is ready to run.
 
-   The idle thread is initially put on the ready list by
-   thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   The bootstrap processor's idle thread is initially put on the
+   ready list by thread_start().  It will be scheduled once
+   initially, at which point it initializes cpus[0].idle_thread,
+   "up"s the semaphore passed to it to enable thread_start() to
+   continue, and immediately blocks.  After that, the idle thread
+   never appears in the ready list.  It is returned by
+   next_thread_to_run() as a special case when the ready list is
+   empty.  The other CPUs' idle threads are entered directly by
+   thread_start_ap(), with a null IDLE_STARTED.
+
+   While it halts the bootstrap processor, the idle thread also
+   stops the periodic timer interrupt until the next sleeping
+   thread is due (see timer_stop_tick()), and restarts it once
+   something wakes the CPU up. */
 static void
-idle (void *idle_started_ UNUSED) 
+idle (void *idle_started_) 
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
-  sema_up (idle_started);
+  bool bsp = idle_started != NULL;
+  struct cpu *c = bsp ? &cpus[0] : cpu_current ();
+
+  if (bsp) 
+    {
+      c->idle_thread = thread_current ();
+      sema_up (idle_started);
+    }
 
   for (;;) 
     {
+      bool ready;
+
       /* Let someone else run. */
       intr_disable ();
+      c->idling = false;
+      if (bsp)
+        timer_resume_tick ();
       thread_block ();
 
+      /* Nothing else is ready.  Clear a free page for palloc's
+         pre-zeroed reserve, if it needs one, and then look again
+         whether anything is ready, so that we never hold up a
+         thread by more than one page's worth of work. */
+      intr_enable ();
+      if (palloc_zero_idle ())
+        continue;
+      intr_disable ();
+
+      /* An interrupt handled while interrupts were on may have
+         made a thread ready on this CPU, without a kick, since
+         we are running.  Halting now would leave it waiting for
+         the next interrupt. */
+      spinlock_acquire (&c->rq_lock);
+      ready = !list_empty (&c->ready_list);
+      spinlock_release (&c->rq_lock);
+      if (ready)
+        continue;
+
+      /* Nothing else is ready, so there is no time slice to
+         enforce until some sleeping thread is due. */
+      if (bsp)
+        timer_stop_tick ();
+      c->idling = true;
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -472,18 +737,167 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
-/* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+/* Returns a page for a new thread, reusing one freed by a dead
+   thread if possible.  Only the part of the page that
+   init_thread() clears is zeroed; the rest is stack.  Returns a
+   null pointer if no memory is available. */
 static struct thread *
-next_thread_to_run (void) 
+alloc_thread_page (void) 
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
-  else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+  struct thread *t = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  spinlock_acquire (&page_cache_lock);
+  if (page_cache_cnt > 0) 
+    {
+      t = page_cache[--page_cache_cnt];
+      page_hits++;
+    }
+  spinlock_release (&page_cache_lock);
+  intr_set_level (old_level);
+
+  if (t == NULL)
+    t = palloc_get_page (PAL_THREAD);
+  return t;
+}
+
+/* Frees dead thread T's page, keeping it in the page cache if
+   there is room.  Interrupts must be off. */
+static void
+free_thread_page (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  spinlock_acquire (&page_cache_lock);
+  if (page_cache_cnt < PAGE_CACHE_SIZE) 
+    {
+      page_cache[page_cache_cnt++] = t;
+      t = NULL;
+    }
+  spinlock_release (&page_cache_lock);
+
+  if (t != NULL)
+    palloc_free_page (t);
+}
+
+/* Returns the CPU that should run a thread that has never run
+   before: the online CPUs take turns.  Interrupts must be off.
+   Two CPUs racing here may pick the same CPU, which is
+   harmless. */
+static struct cpu *
+choose_cpu (void) 
+{
+  static unsigned next_cpu;
+  struct cpu *c;
+
+  do
+    c = &cpus[next_cpu++ % cpu_cnt];
+  while (!c->online);
+  return c;
+}
+
+/* Interrupts one idle CPU other than the current one, if there
+   is any, so that it steals work.  Interrupts must be off. */
+static void
+kick_idle_cpu (void) 
+{
+  struct cpu *cur = cpu_current ();
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].idling && &cpus[i] != cur) 
+      {
+        cpu_kick (&cpus[i]);
+        break;
+      }
+}
+
+/* Returns the CPU other than C with the most threads waiting to
+   run, or a null pointer if no other CPU has any.  The counts
+   are read without locking, so the answer is only a hint. */
+static struct cpu *
+find_victim (struct cpu *c) 
+{
+  struct cpu *victim = NULL;
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++) 
+    {
+      struct cpu *v = &cpus[i];
+      if (v != c && v->online && v->ready_cnt > 0
+          && (victim == NULL || v->ready_cnt > victim->ready_cnt))
+        victim = v;
+    }
+  return victim;
+}
+
+/* Moves half of the threads waiting on the longest other run
+   queue, rounded up, to CPU C's run queue, whose lock must be
+   held, and returns the number moved.
+
+   Threads are taken from the back of the queue, which is the
+   end the victim would get to last.  Threads that ran on the
+   victim in the last CACHE_HOT_NS probably still have their
+   working set in its cache, so they are passed over, unless
+   that would leave C with nothing to run.
+
+   The victim's lock is only tried, never waited for, because
+   two CPUs stealing from each other would otherwise deadlock. */
+static unsigned
+steal (struct cpu *c) 
+{
+  struct cpu *victim = find_victim (c);
+  struct list_elem *e;
+  uint64_t now;
+  unsigned want, moved = 0;
+
+  if (victim == NULL || !spinlock_try_acquire (&victim->rq_lock))
+    return 0;
+
+  now = timer_cycles ();
+  want = (victim->ready_cnt + 1) / 2;
+  for (e = list_rbegin (&victim->ready_list);
+       e != list_rend (&victim->ready_list) && moved < want; ) 
+    {
+      struct thread *t = list_entry (e, struct thread, elem);
+      e = list_prev (e);
+
+      if (t->cpu == victim
+          && timer_cycles_to_ns (now - t->ran_until) < CACHE_HOT_NS)
+        continue;
+      list_remove (&t->elem);
+      list_push_front (&c->ready_list, &t->elem);
+      moved++;
+    }
+  if (moved == 0 && !list_empty (&victim->ready_list)) 
+    {
+      list_push_front (&c->ready_list, list_pop_back (&victim->ready_list));
+      moved++;
+    }
+  victim->ready_cnt -= moved;
+  c->ready_cnt += moved;
+  spinlock_release (&victim->rq_lock);
+
+  if (moved > 0)
+    c->steals++;
+  return moved;
+}
+
+/* Chooses and returns the next thread to be scheduled on CPU C,
+   whose run queue lock must be held.  Should return a thread
+   from the run queue, unless the run queue is empty and there is
+   nothing to steal from other CPUs.  (If the running thread can
+   continue running, then it will be in the run queue.)  If the
+   run queue is empty, return C's idle thread. */
+static struct thread *
+next_thread_to_run (struct cpu *c) 
+{
+  if (list_empty (&c->ready_list) && steal (c) == 0)
+    return c->idle_thread;
+
+  c->ready_cnt--;
+  return list_entry (list_pop_front (&c->ready_list), struct thread, elem);
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -491,7 +905,8 @@ next_thread_to_run (void)
 
    At this function's invocation, we just switched from thread
    PREV, the new thread is already running, and interrupts are
-   still disabled.  This function is normally invoked by
+   still disabled.  The CPU's run queue lock, taken by whoever
+   called schedule(), is still held; we release it here.  This function is normally invoked by
    thread_schedule() as its final action before returning, but
    the first time a thread is scheduled it is called by
    switch_entry() (see switch.S).
@@ -506,6 +921,7 @@ void
 schedule_tail (struct thread *prev) 
 {
   struct thread *cur = running_thread ();
+  struct cpu *c = cur->cpu;
   
   ASSERT (intr_get_level () == INTR_OFF);
 
@@ -513,7 +929,10 @@ schedule_tail (struct thread *prev)
   cur->status = THREAD_RUNNING;
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  c->thread_ticks = 0;
+
+  /* PREV's registers are saved, so other CPUs may pick it up. */
+  spinlock_release (&c->rq_lock);
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -524,32 +943,61 @@ schedule_tail (struct thread *prev)
      thread.  This must happen late so that thread_exit() doesn't
      pull out the rug under itself.  (We don't free
      initial_thread because its memory was not obtained via
-     palloc().) */
+     alloc_thread_page().) */
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      free_thread_page (prev);
     }
 }
 
-/* Schedules a new process.  At entry, interrupts must be off and
-   the running process's state must have been changed from
-   running to some other state.  This function finds another
-   thread to run and switches to it.
+/* Schedules a new process.  At entry, interrupts must be off,
+   the current CPU's run queue lock must be held, and the running
+   process's state must have been changed from running to some
+   other state.  This function finds another thread to run and
+   switches to it.
 
    It's not safe to call printf() until schedule_tail() has
    completed. */
 static void
 schedule (void) 
 {
+  struct cpu *c = cpu_current ();
   struct thread *cur = running_thread ();
-  struct thread *next = next_thread_to_run ();
+  struct thread *next = next_thread_to_run (c);
   struct thread *prev = NULL;
+  uint64_t now;
 
   ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spinlock_held_by_current_cpu (&c->rq_lock));
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  if (cur != next) 
+    {
+      now = timer_cycles ();
+      cur->run_cycles += now - cur->run_since;
+      *run_counter (c, cur) += now - cur->run_since;
+      cur->ran_until = now;
+      if (c->preempting) 
+        {
+          cur->involuntary_switches++;
+          c->involuntary_switches++;
+        }
+      else 
+        {
+          cur->voluntary_switches++;
+          c->voluntary_switches++;
+        }
+      if (next->status == THREAD_READY)
+        account_wait (c, next, now);
+      next->run_since = now;
+    }
+  c->preempting = false;
+  if (next->cpu != NULL && next->cpu != c)
+    c->migrations++;
+  next->cpu = c;
+
   if (cur != next)
     prev = switch_threads (cur, next);
   schedule_tail (prev);
@@ -557,6 +1005,43 @@ schedule (void)
   //printf("I AM WOMAN, HEAR ME SMASH %s\n",cur->name);
 }
 
+/* Charges thread T, about to run on CPU C at time NOW, for the
+   time it waited in the ready queue.  Bucket I of C's histogram
+   counts waits of 2**I to 2**(I+1) - 1 timer_cycles(). */
+static void
+account_wait (struct cpu *c, struct thread *t, uint64_t now) 
+{
+  uint64_t wait = now - t->ready_since;
+  int bucket = 0;
+
+  t->wait_cycles += wait;
+  if (wait > t->max_wait_cycles)
+    t->max_wait_cycles = wait;
+  if (wait > c->max_wait_cycles)
+    c->max_wait_cycles = wait;
+
+  /* Index of the most significant set bit. */
+  if (wait >> 32)
+    bucket = 63 - __builtin_clz ((uint32_t) (wait >> 32));
+  else if (wait != 0)
+    bucket = 31 - __builtin_clz ((uint32_t) wait);
+  c->wait_hist[bucket]++;
+}
+
+/* Returns the counter of CPU C that time spent running thread T
+   is charged to: idle, user program, or kernel thread. */
+static uint64_t *
+run_counter (struct cpu *c, struct thread *t) 
+{
+  if (t == c->idle_thread)
+    return &c->idle_cycles;
+#ifdef USERPROG
+  if (t->pagedir != NULL)
+    return &c->user_cycles;
+#endif
+  return &c->kernel_cycles;
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) 
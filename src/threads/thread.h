@@ -7,6 +7,11 @@
 
 #include "userprog/flist.h"
 
+struct cpu;
+struct file;
+struct hash;
+struct spinlock;
+
 /* States in a thread's life cycle. */
 enum thread_status
   {
@@ -76,12 +81,13 @@ typedef int tid_t;
    the `magic' member of the running thread's `struct thread' is
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+/* The `elem' member is an element in the run queue (thread.c),
+   and `wait_elem' is an element in a semaphore wait list
+   (synch.c).  They used to be one member, since only a ready
+   thread is on the run queue and only a blocked thread waits on
+   a semaphore, but a thread whose timed wait runs out is made
+   ready by the timer while it is still on the semaphore's list,
+   until it gets around to taking itself off. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -92,7 +98,33 @@ struct thread
     int priority;                       /* Priority. */
 
     /* Shared between thread.c and synch.c. */
-    struct list_elem elem;              /* List element. */
+    struct list_elem elem;              /* Run queue element. */
+
+    /* Owned by synch.c. */
+    struct list_elem wait_elem;         /* Semaphore wait list element. */
+
+    /* Owned by thread.c. */
+    struct cpu *cpu;                    /* CPU last run on, or null. */
+
+    /* Scheduling statistics, in timer_cycles() units.
+       Owned by thread.c. */
+    uint64_t ready_since;               /* When last made ready. */
+    uint64_t run_since;                 /* When last switched in. */
+    uint64_t ran_until;                 /* When last switched out. */
+    uint64_t run_cycles;                /* Total time running. */
+    uint64_t wait_cycles;               /* Total time in the ready queue. */
+    uint64_t max_wait_cycles;           /* Longest single ready wait. */
+    unsigned voluntary_switches;        /* # of times it gave up the CPU. */
+    unsigned involuntary_switches;      /* # of times it was preempted. */
+
+    /* Owned by devices/timer.c. */
+    int64_t wakeup_tick;                /* Tick to wake up at, if sleeping. */
+    struct list_elem sleep_elem;        /* Sleep list element. */
+    volatile int wait_state;            /* State of a timed wait. */
+
+    /* Owned by threads/palloc.c. */
+    size_t pages;                       /* User pages and page tables. */
+    size_t peak_pages;                  /* Most PAGES ever held. */
 
     /* YES! You may want to add stuff. But make note of point 2 above. */
     struct map file_list;             /* File descriptors for processes' open files */
@@ -101,6 +133,16 @@ struct thread
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
 #endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash *page_table;            /* Supplemental page table. */
+    struct file *exec_file;             /* Executable, to load pages from. */
+    void *user_esp;                     /* User esp on kernel entry. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory mappings. */
+    int next_mapid;                     /* Next mapping identifier. */
+#endif
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
@@ -120,7 +162,12 @@ void thread_print_stats (void);
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
 
+struct thread *thread_create_idle (struct cpu *);
+void thread_start_ap (void) NO_RETURN;
+
 void thread_block (void);
+void thread_block_release (struct spinlock *);
+void thread_block_release2 (struct spinlock *, struct spinlock *);
 void thread_unblock (struct thread *);
 
 struct thread *thread_current (void);
@@ -129,6 +176,7 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_preempt (void);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
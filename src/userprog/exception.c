@@ -4,6 +4,10 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -148,9 +152,18 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
-  /* To implement virtual memory, delete the rest of the function
-     body, and replace it with code that brings in the page to
-     which fault_addr refers. */
+#ifdef VM
+  /* Bring in a page that is not in memory, or grow the stack.
+     The kernel faults here too when a system call touches such a
+     page in a user buffer, in which case the user's stack pointer
+     is the one saved on entry to the kernel. */
+  if (not_present && is_user_vaddr (fault_addr)
+      && (page_load (fault_addr)
+          || page_grow_stack (fault_addr,
+                              user ? f->esp : thread_current ()->user_esp)))
+    return;
+#endif
+
   printf ("Page fault at %p: %s error %s page in %s context.\n",
           fault_addr,
           not_present ? "not present" : "rights violation",
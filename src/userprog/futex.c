@@ -0,0 +1,168 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Futexes ("fast user-space mutexes") let user processes block
+   until another process wakes them up, instead of polling.
+
+   A futex is an int in a file, named by the file's inode and the
+   int's byte offset, so every process that has the file open
+   gets to the same futex, whatever its file position.  A process
+   that sees a value it has to wait for calls futex_wait() with
+   that value; the wait only blocks if the file still holds it,
+   which is checked under the same lock that futex_wake() takes.
+   So a process that changes the value and then calls
+   futex_wake() cannot slip in between the check and the sleep.
+
+   There is one wait queue for each futex that has waiters, in a
+   hash table keyed on (inode, offset).  Shared memory mappings
+   can use the same table, by turning an address into the inode
+   and offset it maps. */
+
+/* Wait queue for one futex. */
+struct futex
+  {
+    struct hash_elem hash_elem;         /* Element in `futexes'. */
+    struct inode *inode;                /* Inode of the file. */
+    off_t offset;                       /* Byte offset in the file. */
+    struct list waiters;                /* List of struct futex_waiter. */
+  };
+
+/* A thread blocked in futex_wait(). */
+struct futex_waiter
+  {
+    struct list_elem elem;              /* Element in futex's `waiters'. */
+    struct semaphore sema;              /* Upped to wake the thread. */
+  };
+
+/* Futexes that have waiters, and the lock that protects them. */
+static struct hash futexes;
+static struct lock futex_lock;
+
+static hash_hash_func futex_hash;
+static hash_less_func futex_less;
+static struct futex *futex_lookup (struct inode *, off_t offset);
+
+/* Initializes the futex table. */
+void
+futex_init (void) 
+{
+  hash_init (&futexes, futex_hash, futex_less, NULL);
+  lock_init_named (&futex_lock, "futex_lock");
+}
+
+/* If the int at byte OFFSET in FILE equals EXPECTED, blocks until
+   another process wakes up the futex there with futex_wake() and
+   returns 0.  Otherwise, or if OFFSET is not within FILE, returns
+   -1 at once. */
+int
+futex_wait (struct file *file, off_t offset, int expected) 
+{
+  struct futex_waiter waiter;
+  struct futex *f;
+  int value;
+
+  ASSERT (file != NULL);
+
+  lock_acquire (&futex_lock);
+  if (offset < 0
+      || file_read_at (file, &value, sizeof value, offset) != sizeof value
+      || value != expected) 
+    {
+      lock_release (&futex_lock);
+      return -1;
+    }
+
+  f = futex_lookup (file_get_inode (file), offset);
+  if (f == NULL) 
+    {
+      f = malloc_tagged (sizeof *f, MALLOC_PROCESS);
+      if (f == NULL) 
+        {
+          lock_release (&futex_lock);
+          return -1;
+        }
+      f->inode = file_get_inode (file);
+      f->offset = offset;
+      list_init (&f->waiters);
+      hash_insert (&futexes, &f->hash_elem);
+    }
+  sema_init (&waiter.sema, 0);
+  list_push_back (&f->waiters, &waiter.elem);
+  lock_release (&futex_lock);
+
+  sema_down (&waiter.sema);
+  return 0;
+}
+
+/* Wakes up to CNT processes blocked on the futex at byte OFFSET
+   in FILE, in the order they started waiting, and returns how
+   many it woke up. */
+int
+futex_wake (struct file *file, off_t offset, int cnt) 
+{
+  struct futex *f;
+  int woken = 0;
+
+  ASSERT (file != NULL);
+
+  lock_acquire (&futex_lock);
+  f = futex_lookup (file_get_inode (file), offset);
+  if (f != NULL) 
+    {
+      while (woken < cnt && !list_empty (&f->waiters)) 
+        {
+          struct futex_waiter *w = list_entry (list_pop_front (&f->waiters),
+                                               struct futex_waiter, elem);
+          sema_up (&w->sema);
+          woken++;
+        }
+      if (list_empty (&f->waiters)) 
+        {
+          hash_delete (&futexes, &f->hash_elem);
+          free (f);
+        }
+    }
+  lock_release (&futex_lock);
+
+  return woken;
+}
+
+/* Returns the futex for OFFSET in INODE, or a null pointer if no
+   one waits on it.  futex_lock must be held. */
+static struct futex *
+futex_lookup (struct inode *inode, off_t offset) 
+{
+  struct futex key;
+  struct hash_elem *e;
+
+  key.inode = inode;
+  key.offset = offset;
+  e = hash_find (&futexes, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct futex, hash_elem) : NULL;
+}
+
+/* Returns a hash value for futex E. */
+static unsigned
+futex_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  const struct futex *f = hash_entry (e, struct futex, hash_elem);
+
+  return hash_int ((int) f->inode) ^ hash_int (f->offset);
+}
+
+/* Returns true if futex A precedes futex B. */
+static bool
+futex_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED) 
+{
+  const struct futex *a = hash_entry (a_, struct futex, hash_elem);
+  const struct futex *b = hash_entry (b_, struct futex, hash_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  return a->offset < b->offset;
+}
@@ -0,0 +1,10 @@
+#ifndef USERPROG_FUTEX_H
+#define USERPROG_FUTEX_H
+
+#include "filesys/file.h"
+
+void futex_init (void);
+int futex_wait (struct file *, off_t offset, int expected);
+int futex_wake (struct file *, off_t offset, int cnt);
+
+#endif /* userprog/futex.h */
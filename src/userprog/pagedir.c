@@ -7,6 +7,9 @@
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
@@ -22,7 +25,7 @@ bool verify_fix_length(void* start, int length)
   void* iterator = start;
   while ( pg_round_down(iterator) < start+length )
     {
-      void* page = pagedir_get_page(thread_current()->pagedir,iterator);
+      void* page = pagedir_get_user_page(iterator);
       if(page == NULL)
 	return false;
 
@@ -39,7 +42,7 @@ bool verify_variable_length(char* start)
 {
   // ADD YOUR CODE HERE
   //  void* pagedir = thread_current()->pagedir;
-  void* page = pagedir_get_page(thread_current()->pagedir,pg_round_down(start));
+  void* page = pagedir_get_user_page(pg_round_down(start));
   char* iterator = start;
 
   unsigned cnt = start - (unsigned)pg_round_down(start);
@@ -51,7 +54,7 @@ bool verify_variable_length(char* start)
     {
       if( ++cnt%PGSIZE == 0)
 	{
-	  page = pagedir_get_page(thread_current()->pagedir,iterator);
+	  page = pagedir_get_user_page(iterator);
 	}
       
       if(page == NULL)
@@ -60,6 +63,27 @@ bool verify_variable_length(char* start)
   return true;
 }
 
+/* Returns the kernel address that user address UADDR of the
+   running process maps to, or a null pointer if UADDR is
+   unmapped.  With VM, a page that is not in memory is loaded
+   first, and a buffer in the part of the stack that has not been
+   touched yet grows the stack, so a system call may check its
+   arguments. */
+void *
+pagedir_get_user_page (const void *uaddr)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  void *kaddr = pagedir_get_page (pd, uaddr);
+
+#ifdef VM
+  if (kaddr == NULL
+      && (page_load (uaddr)
+          || page_grow_stack (uaddr, thread_current ()->user_esp)))
+    kaddr = pagedir_get_page (pd, uaddr);
+#endif
+  return kaddr;
+}
+
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
    Returns the new page directory, or a null pointer if memory
@@ -67,7 +91,7 @@ bool verify_variable_length(char* start)
 uint32_t *
 pagedir_create (void) 
 {
-  uint32_t *pd = palloc_get_page (0);
+  uint32_t *pd = palloc_get_page (PAL_PAGEDIR);
   if (pd != NULL)
     memcpy (pd, base_page_dir, PGSIZE);
   return pd;
@@ -121,7 +145,7 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
     {
       if (create)
         {
-          pt = palloc_get_page (PAL_ZERO);
+          pt = palloc_get_page (PAL_ZERO | PAL_PAGEDIR);
           if (pt == NULL) 
             return NULL; 
       
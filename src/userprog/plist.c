@@ -5,197 +5,292 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
 #include <string.h>
+
+/* Number of generations a slot goes through before its pids
+   come around again, keeping every pid a positive int. */
+#define GENERATIONS (INT_MAX / PLIST_SLOTS_MAX)
+
+static struct pslot* slot_of(struct plist*, int);
+static bool grow(struct plist*);
+static value_p lookup(struct plist*, int);
+static void release(struct plist*, value_p);
+
+static struct kmem_cache* pinfos_cache; // where the pinfos live
  
 
 void 
 plist_init(struct plist* m)
 {
-  unsigned i;
-  for(i = 0; i < LIST_SIZE; ++i)
-    {
-      m->content[i] = NULL;
-    }
+  m->chunk_cnt = 0;
+  m->free_head = m->free_tail = -1;
+  if(pinfos_cache == NULL)
+    pinfos_cache = kmem_cache_create("pinfos", sizeof(struct pinfos), NULL);
   return;
 }
 
+/*
+ * Inserts a copy of @t as a new process, a child of t->parent_id, and
+ * returns its pid, or -1 if the table is full or memory ran out
+ */
 key_t
 plist_insert(struct plist* m, value_p t)
 {
-  unsigned i;
-  for(i = 0; i < LIST_SIZE; ++i)
+  value_p p = kmem_cache_alloc(pinfos_cache);
+  value_p parent;
+  int slot;
+
+  if(p == NULL)
+    return -1;
+
+  strlcpy(p->name, t->name, sizeof p->name);
+  p->parent_id = t->parent_id;
+  p->alive = t->alive;
+  p->parent_alive = t->parent_alive;
+  p->thread = t->thread;
+  p->exit_status = t->exit_status;
+  sema_init(&p->exit_status_available, 0);
+  list_init(&p->children);
+
+  lock_acquire(&m->phatlock); /* LOCK */
+  if(m->free_head == -1 && !grow(m))
     {
-      lock_acquire(&m->phatlock); /* LOCK */
-      if(m->content[i] == NULL)
-	{
-	  //allocate memory for the struct (never cast return of malloc in c I learnt from stackoverflow.com)
-	  m->content[i]         = malloc(sizeof(struct pinfos));
-	  //need to allocate space for the char * as well should be of size 16 chars I think
-	  m->content[i]->name   = malloc(sizeof(char)*16);
-	  
-	  strlcpy(m->content[i]->name,t->name,strlen(t->name));
-	  m->content[i]->parent_id = t->parent_id;
-	  m->content[i]->alive = t->alive;
-	  m->content[i]->parent_alive = t->parent_alive;
-	  m->content[i]->exit_status = t->exit_status;
-	  //	  m->content[i]->ret_available = true;
-
-	  m->content[i]->exit_status_available = t->exit_status_available;
-	  sema_init(&m->content[i]->exit_status_available, 0 );
-	  lock_release(&m->phatlock); /* LOCK */
-	  return i;
-	}
       lock_release(&m->phatlock); /* LOCK */
+      kmem_cache_free(pinfos_cache, p);
+      return -1;
     }
- 
-  return -1;
+  slot = m->free_head;
+  m->free_head = slot_of(m, slot)->next_free;
+  if(m->free_head == -1)
+    m->free_tail = -1;
+  p->pid = slot_of(m, slot)->generation * PLIST_SLOTS_MAX + slot;
+  slot_of(m, slot)->proc = p;
+
+  /* the kernel (parent -1) has no record and never dies */
+  parent = lookup(m, p->parent_id);
+  if(parent != NULL)
+    list_push_back(&parent->children, &p->child_elem);
+  lock_release(&m->phatlock); /* LOCK */
+
+  return p->pid;
 }
 
 value_p 
-plist_find(struct plist* m, int i)
+plist_find(struct plist* m, int pid)
 {
-  lock_acquire(&m->phatlock); /* LOCK */
-
-  if(i >= 0 && i < LIST_SIZE)
-    {
-      lock_release(&m->phatlock); /* LOCK */
-      return m->content[i];
-    }
+  value_p p;
 
+  lock_acquire(&m->phatlock); /* LOCK */
+  p = lookup(m, pid);
   lock_release(&m->phatlock); /* LOCK */
-  return NULL;
+  return p;
 }
 
-value_p
-plist_remove(struct plist* m, int i)
+bool
+plist_alive(struct plist* m, int pid)
 {
+  value_p p;
+  bool alive;
+
   lock_acquire(&m->phatlock); /* LOCK */
-  
-  if(i >= 0 && i < LIST_SIZE && m->content[i] != NULL)
-    {
-      value_p temp = m->content[i];
-      free(m->content[i]->name);
-      free(m->content[i]);
-      //      m->content[i]->ret_available = false;
-      m->content[i] = NULL;
+  p = lookup(m, pid);
+  alive = p != NULL && p->alive;
+  lock_release(&m->phatlock); /* LOCK */
+  return alive;
+}
 
-      lock_release(&m->phatlock); /* LOCK */
-      return temp;
-    }
+int
+plist_get_status(struct plist* m, int pid)
+{
+  value_p p;
+  int status;
 
+  lock_acquire(&m->phatlock); /* LOCK */
+  p = lookup(m, pid);
+  status = p != NULL ? p->exit_status : -1;
   lock_release(&m->phatlock); /* LOCK */
-  return NULL;
+  return status;
 }
 
 bool
-plist_alive(struct plist* m, int i)
+plist_is_child(struct plist* m, int child, int parent)
 {
-  //check i > LIST_SIZE ?
+  value_p p;
+  bool result;
+
   lock_acquire(&m->phatlock); /* LOCK */
+  p = lookup(m, child);
+  result = p != NULL && p->parent_id == parent && p->parent_alive;
+  lock_release(&m->phatlock); /* LOCK */
+
+  return result;
+}
 
-  if(m->content[i] != NULL)
+/*
+ * Waits for process @child of process @parent to die, reaps it and
+ * returns its exit status. Returns -1 at once if @child is not an
+ * unreaped child of @parent
+ */
+int
+plist_wait(struct plist* m, int child, int parent)
+{
+  value_p p;
+  int status;
+
+  lock_acquire(&m->phatlock); /* LOCK */
+  p = lookup(m, child);
+  if(p == NULL || p->parent_id != parent || !p->parent_alive)
     {
       lock_release(&m->phatlock); /* LOCK */
-      return m->content[i]->alive;
+      return -1;
     }
-  
   lock_release(&m->phatlock); /* LOCK */
-  return NULL;
-}
 
-int
-plist_get_status(struct plist* m, int i)
-{
+  /* the record stays put until we reap it, as we are still alive */
+  sema_down(&p->exit_status_available);
+
   lock_acquire(&m->phatlock); /* LOCK */
-  int status;
-  if(m->content[i] != NULL)
-    status = m->content[i]->exit_status;
-  else
-    status = -1;
-  lock_release(&m->phatlock);
+  status = p->exit_status;
+  if(lookup(m, parent) != NULL)
+    list_remove(&p->child_elem);
+  release(m, p);
+  lock_release(&m->phatlock); /* LOCK */
+
   return status;
 }
 
-bool
-plist_is_child(struct plist* m, int child, int parent)
+/*
+ * Marks process @pid dead. Its dead children will never be waited
+ * for and are reaped now, the living ones become orphans. Its own
+ * record stays for its parent to reap, unless the parent died first
+ */
+void
+plist_exit(struct plist* m, int pid)
 {
-  lock_acquire(&m->phatlock);
-  //printf("child id: %d, parent id: %d\n", child, parent);
-  bool result;
+  value_p p;
+  struct list_elem* e;
 
-  if(child > LIST_SIZE)
-    result = false;
-  else if ( m->content[child] == NULL )
-    result = false;
-  else if( m->content[child]->parent_id == parent && m->content[child]->parent_alive )
-    result = true;
-  else
-    result = false;
-  
+  lock_acquire(&m->phatlock); /* LOCK */
+  p = lookup(m, pid);
+  if(p == NULL)
+    {
+      lock_release(&m->phatlock); /* LOCK */
+      return;
+    }
 
-  lock_release(&m->phatlock);
-  
-  //  printf("child id: %d, parent id: %d after release\n", child, parent);
+  for(e = list_begin(&p->children); e != list_end(&p->children); )
+    {
+      value_p c = list_entry(e, struct pinfos, child_elem);
+      e = list_remove(e);
+      c->parent_alive = false;
+      if(!c->alive)
+        release(m, c);
+    }
 
-  return result;
+  p->alive = false;
+  p->thread = NULL;
+  if(p->parent_alive)
+    sema_up(&p->exit_status_available);
+  else
+    release(m, p);
+  lock_release(&m->phatlock); /* LOCK */
 }
 
 void
 plist_for_each(struct plist* m, void (*exec)(int,value_p,int), int aux)
 {
-  unsigned i;
-  for(i = 0; i < LIST_SIZE; ++i)
+  int i;
+  lock_acquire(&m->phatlock);
+  for(i = 0; i < m->chunk_cnt * PLIST_CHUNK; ++i)
     {
-      lock_acquire(&m->phatlock);
-      if(m->content[i] != NULL)
-	exec(i, m->content[i], aux);
-      lock_release(&m->phatlock);
+      value_p p = slot_of(m, i)->proc;
+      if(p != NULL)
+	exec(p->pid, p, aux);
     }
+  lock_release(&m->phatlock);
 }
 
+/*
+ * Returns slot number @i, which must exist
+ */
+static struct pslot*
+slot_of(struct plist* m, int i)
+{
+  return &m->chunks[i / PLIST_CHUNK][i % PLIST_CHUNK];
+}
 
-void
-plist_remove_if(struct plist* m, bool (*cond)(int,value_p,int), int aux)
+/*
+ * Adds a chunk of free slots to the table. Returns false if the
+ * table is as big as it gets or memory ran out. The lock must be held
+ */
+static bool
+grow(struct plist* m)
 {
-  unsigned i;
-  for(i = 0; i < LIST_SIZE; ++i)
+  struct pslot* chunk;
+  int first, i;
+
+  if(m->chunk_cnt == PLIST_CHUNKS_MAX)
+    return false;
+  chunk = malloc(PLIST_CHUNK * sizeof *chunk);
+  if(chunk == NULL)
+    return false;
+
+  first = m->chunk_cnt * PLIST_CHUNK;
+  for(i = 0; i < PLIST_CHUNK; ++i)
     {
-      lock_acquire(&m->phatlock); 
-      if ( m->content[i] != NULL && cond(i, m->content[i], aux) )
-	{
-	  lock_release(&m->phatlock);
-	  plist_remove(m,i);
-	  continue;
-	}
-      lock_release(&m->phatlock);
+      chunk[i].proc = NULL;
+      chunk[i].generation = 0;
+      chunk[i].next_free = i + 1 < PLIST_CHUNK ? first + i + 1 : -1;
     }
+  m->chunks[m->chunk_cnt++] = chunk;
+
+  /* only called with an empty free queue */
+  m->free_head = first;
+  m->free_tail = first + PLIST_CHUNK - 1;
+  return true;
 }
 
-bool
-is_candidate(int i, value_p p, int aux)
+/*
+ * Returns the record of process @pid, or NULL. The lock must be held
+ */
+static value_p
+lookup(struct plist* m, int pid)
 {
-  if( !(p->parent_alive || p->alive) )
-    return true;
+  int slot = pid % PLIST_SLOTS_MAX;
+  value_p p;
 
-  return false;
+  if(pid < 0 || slot >= m->chunk_cnt * PLIST_CHUNK)
+    return NULL;
+  p = slot_of(m, slot)->proc;
+  return p != NULL && p->pid == pid ? p : NULL;
 }
 
 /*
- * Danger! This function is supposed to be used ONLY if 
- * parent (aux) is dead AND parent (aux) is still in the list.
- * If that is not the case aux could potentially be a new process
- * with own children not at all related to the original aux
+ * Frees the record @p and its slot, which gets a new generation so
+ * that the old pid stays dead, and goes to the back of the free
+ * queue. The lock must be held
  */
-void
-update_parent(int i, value_p p, int aux)
+static void
+release(struct plist* m, value_p p)
 {
-   if( p->parent_id == aux )
-    p->parent_alive = false;
-  
-  //  if( !(p->alive && p->parent_alive) )
-  //    p->garbage = true;
-   if( i == aux )
-    p->alive = false;
+  int slot = p->pid % PLIST_SLOTS_MAX;
+  struct pslot* s = slot_of(m, slot);
+
+  s->proc = NULL;
+  s->generation = (s->generation + 1) % GENERATIONS;
+  s->next_free = -1;
+  if(m->free_tail == -1)
+    m->free_head = slot;
+  else
+    slot_of(m, m->free_tail)->next_free = slot;
+  m->free_tail = slot;
+  kmem_cache_free(pinfos_cache, p);
 }
 
 void
@@ -207,18 +302,41 @@ print_list(struct plist* p)
 
   printf("# TOP\n");
   printf("PID\tPARENTID\tALIVE\tPARENT_ALIVE\tEXIT_STATUS\tNAME\n");
-    for(i = 0; i < LIST_SIZE; ++i)
+    for(i = 0; i < p->chunk_cnt * PLIST_CHUNK; ++i)
       {
-	if(p->content[i] == NULL)
+	value_p r = slot_of(p, i)->proc;
+	if(r == NULL)
 	  continue;
 	
 	printf("%d\t%d\t\t%d\t%d\t\t%d\t\t%s\n",
-	       i, 
-	       p->content[i]->parent_id, 
-	       p->content[i]->alive,
-	       p->content[i]->parent_alive,
-	       p->content[i]->exit_status,
-	       p->content[i]->name );
+	       r->pid, 
+	       r->parent_id, 
+	       r->alive,
+	       r->parent_alive,
+	       r->exit_status,
+	       r->name );
+      }
+
+  /* Scheduling and memory statistics of the processes still running */
+  printf("PID\tVOL_SW\tINVOL_SW\tRUN_US\tWAIT_US\tMAX_WAIT_US\tPAGES\tPEAK_PAGES\n");
+    for(i = 0; i < p->chunk_cnt * PLIST_CHUNK; ++i)
+      {
+	value_p r = slot_of(p, i)->proc;
+	struct thread* t;
+
+	if(r == NULL || r->thread == NULL)
+	  continue;
+
+	t = r->thread;
+	printf("%d\t%u\t%u\t\t%"PRId64"\t%"PRId64"\t%"PRId64"\t\t%zu\t%zu\n",
+	       r->pid,
+	       t->voluntary_switches,
+	       t->involuntary_switches,
+	       timer_cycles_to_ns(t->run_cycles) / 1000,
+	       timer_cycles_to_ns(t->wait_cycles) / 1000,
+	       timer_cycles_to_ns(t->max_wait_cycles) / 1000,
+	       t->pages,
+	       t->peak_pages );
       }
     lock_release(&p->phatlock);
 }
@@ -226,18 +344,11 @@ print_list(struct plist* p)
 void
 set_exit_status(struct plist* p, int status, int pid)
 {
-  //check pid < LIST_SIZE ?
+  value_p r;
+
   lock_acquire(&p->phatlock);
-  p->content[pid]->exit_status = status;
+  r = lookup(p, pid);
+  if(r != NULL)
+    r->exit_status = status;
   lock_release(&p->phatlock);
 }
-
-/*
-void
-map_clear(struct map* m)
-{
-  unsigned i;
-  for ( i = 0; i < MAP_SIZE; ++i )
-    map_remove(m,i);
-}
-*/
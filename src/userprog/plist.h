@@ -28,46 +28,70 @@
      clean, readable format.
      
  */
-#define LIST_SIZE 128
 
+#include <list.h>
 #include <stdbool.h>
 #include "threads/synch.h"
 
+/* The table grows by one chunk of PLIST_CHUNK slots whenever it
+   runs out of free slots, up to PLIST_SLOTS_MAX slots, which is
+   far more processes than fit in memory at once. */
+#define PLIST_CHUNK 64
+#define PLIST_SLOTS_MAX 65536
+#define PLIST_CHUNKS_MAX (PLIST_SLOTS_MAX / PLIST_CHUNK)
+
 struct pinfos;
+struct thread;
 typedef struct pinfos* value_p;
 typedef int key_t;
 
+/* A pid is a slot number in the table plus PLIST_SLOTS_MAX times
+   the generation of that slot, which is bumped every time the slot
+   is freed. So a pid is never handed out again while anyone could
+   still hold the old one, and looking it up only needs the slot.
+   Freed slots are reused oldest first, which spreads the
+   generations over all slots and keeps pids from coming around
+   again for a long time. */
 
 struct pinfos {
+  int   pid;       // my own process id
   int   parent_id; // I am the spawn of this fellow
   int   exit_status; // this is how I died
-  char* name;
+  char  name[16];
   bool  alive; // I am beyond the realm of the living, or am I ?
   bool  parent_alive; // I am an orphan, or just a melodramatic kid ?
-  //  bool  ret_available;
-  struct semaphore exit_status_available;
+  struct thread* thread; // my thread while I am alive, for statistics
+  struct semaphore exit_status_available; // upped when I die
+  struct list children;        // my children that are not reaped yet
+  struct list_elem child_elem; // element in my parent's `children'
+};
+
+/* One slot in the table. */
+struct pslot {
+  value_p  proc;       // the process in this slot, or NULL if free
+  unsigned generation; // bumped whenever the slot is freed
+  int      next_free;  // next slot on the free queue, or -1
 };
 
 struct plist {
-  value_p content[LIST_SIZE];
+  struct pslot* chunks[PLIST_CHUNKS_MAX]; // PLIST_CHUNK slots each
+  int      chunk_cnt;
+  int      free_head;  // queue of free slots, oldest first, or -1
+  int      free_tail;
   struct lock phatlock;
 };
 
 void     plist_init       (struct plist*);
 key_t    plist_insert     (struct plist*, value_p);
 value_p  plist_find       (struct plist*, int);
-value_p  plist_remove     (struct plist*, int);
 bool     plist_alive      (struct plist*, int);
 int      plist_get_status (struct plist*, int);
 bool     plist_is_child   (struct plist*, int, int);
-
+int      plist_wait       (struct plist*, int, int);
+void     plist_exit       (struct plist*, int);
 
 void     plist_for_each  (struct plist*, void (*exec)(int,value_p,int), int);
-void     plist_remove_if (struct plist*, bool (*cond)(int,value_p,int), int);
-//void     map_clear     (struct map*);
 
-bool is_candidate(int, value_p, int);
-void update_parent(int, value_p, int);
 void print_list(struct plist*);
 void set_exit_status(struct plist*, int, int);
 
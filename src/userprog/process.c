@@ -13,6 +13,11 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"     /* PHYS_BASE */
 #include "threads/interrupt.h" /* if_ */
+#include "devices/timer.h"     /* timer_ns */
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 /* Headers not yet used that you may need for various reasons. */
 #include "threads/synch.h"
@@ -26,13 +31,30 @@
 //#define HACK
 
 struct plist PROCESS_LIST; /* Global process list */ 
+
+/* Time from process_execute() to the first user instruction, in
+   nanoseconds, over all processes that started. */
+static struct lock exec_stats_lock;
+static long long exec_cnt;
+static int64_t exec_total_ns;
+static int64_t exec_max_ns;
  
 /* This function is called at boot time (threads/init.c) to initialize
  * the process subsystem. */
 void process_init(void)
 {  
   plist_init(&PROCESS_LIST);
-  lock_init(&PROCESS_LIST.phatlock);
+  lock_init_named(&PROCESS_LIST.phatlock, "plist phatlock");
+  lock_init_named(&exec_stats_lock, "exec_stats_lock");
+}
+
+/* Prints how long processes took from exec to running. */
+void process_print_stats(void)
+{
+  printf("Process: %lld execs, %lld us average and %lld us longest "
+         "from exec to first instruction\n", exec_cnt,
+         exec_cnt > 0 ? exec_total_ns / exec_cnt / 1000 : 0,
+         exec_max_ns / 1000);
 }
 
 /* This function is currently never called. As thread_exit does not
@@ -63,6 +85,7 @@ struct parameters_to_start_process
   struct semaphore sema;
   bool load;
   int par_id;
+  int64_t start;  /* timer_ns() when exec was called */
 };
 
 static void
@@ -93,12 +116,13 @@ process_execute (const char *command_line)
   /* Init semaphore & load variable*/
   sema_init(&arguments.sema, 0);
   arguments.load = false;
+  arguments.start = timer_ns();
 
   /* Store parents(this) thread id, used in child process later*/
   arguments.par_id = thread_current()->pid;
 
   /* COPY command line out of parent process memory */
-  arguments.command_line = malloc(command_line_size);
+  arguments.command_line = malloc_tagged(command_line_size, MALLOC_PROCESS);
   strlcpy(arguments.command_line, command_line, command_line_size);
 
 
@@ -183,9 +207,10 @@ start_process (struct parameters_to_start_process* parameters)
   struct pinfos temp;
   temp.parent_id = parameters->par_id;
   temp.exit_status = -1;
-  temp.name = thread_current()->name;
+  strlcpy(temp.name, thread_current()->name, sizeof temp.name);
   temp.alive = true;
   temp.parent_alive = true;
+  temp.thread = thread_current();
 
   /* debug("#before inserting into PROCESS_LIST\n"); */ 
   thread_current()->pid = plist_insert( &PROCESS_LIST,&temp );
@@ -193,12 +218,12 @@ start_process (struct parameters_to_start_process* parameters)
   
   parameters->par_id = thread_current()->pid;
 
-  /* Check if list was full, we do not allow more than LIST_SIZE processes to run concurrently */
+  /* Check if the process table could not take us (out of memory) */
   if(thread_current()->pid == -1)
     {
       success = false;
       parameters->load = false;
-      debug("# ERROR: System-wide file list was full, killing thread\n");
+      debug("# ERROR: No room in the process table, killing thread\n");
     }
   
   if (success)
@@ -235,6 +260,15 @@ start_process (struct parameters_to_start_process* parameters)
      a `struct intr_frame', we just point the stack pointer (%esp) to
      our stack frame and jump to it. */
 
+  /* Count the exec latency before the parent may free PARAMETERS */
+  int64_t elapsed = timer_ns() - parameters->start;
+  lock_acquire(&exec_stats_lock);
+  exec_cnt++;
+  exec_total_ns += elapsed;
+  if (elapsed > exec_max_ns)
+    exec_max_ns = elapsed;
+  lock_release(&exec_stats_lock);
+
   /* Allow parent process to continue */
   sema_up(&parameters->sema);
   //printf("after sema up start proc\n");
@@ -263,16 +297,9 @@ process_wait (int child_id)
   debug("%s#%d: process_wait(%d) ENTERED\n",
         cur->name, cur->tid, child_id);
   
-  /* Yes! You need to do something good here ! */
-  /* is this really our child ? */
-  if( p->content[child_id] == NULL ) /* trying to fix wait twice ...*/
-    return status;
-  if( plist_is_child(p, child_id, pid) )
-    {
-      sema_down(&p->content[child_id]->exit_status_available);
-      status = plist_get_status(p,child_id);
-      plist_remove(p, child_id);
-    }
+  /* Blocks on the child's own semaphore, then reaps it. Returns -1
+     at once if it is not our child or was already waited for. */
+  status = plist_wait(p, child_id, pid);
   
 
   debug("%s#%d: process_wait(%d) RETURNS %d\n",
@@ -319,15 +346,12 @@ process_cleanup (void)
   /* Clear the file list */
   map_clear(&(cur->file_list));
 
-  if ( pid != -1 ) /* How to deal with threads that are not processes! */
-    {
-      /* Let parent process know we're done */  
-      plist_for_each(p,&update_parent, pid);
-      sema_up(&p->content[pid]->exit_status_available);
-      plist_remove_if(p,&is_candidate, pid);
-      
-    }
-  //printf("%s: pid: %d\n", thread_name(), pid);
+#ifdef VM
+  /* Write back mapped files, then free the pages and swap slots and
+     close the executable */
+  mmap_table_destroy();
+  page_table_destroy();
+#endif
 
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
@@ -344,6 +368,16 @@ process_cleanup (void)
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
+
+  // Only tell the parent once our memory is given back and mapped
+  // files are written, so that what it sees after wait is final
+  if ( pid != -1 ) /* How to deal with threads that are not processes! */
+    {
+      /* Let parent process know we're done, orphan our children */
+      plist_exit(p, pid);
+
+    }
+  //printf("%s: pid: %d\n", thread_name(), pid);
   //  process_print_list();
   debug("%s#%d: process_cleanup() DONE with status %d\n",
         cur->name, cur->tid, status);
@@ -448,6 +482,12 @@ void* setup_main_stack(const char* command_line, void* stack_top)
   /* calculate where the final stack top will be located */
   esp = (struct main_args *)((int)stack_top - total_size);
 
+#ifdef VM
+  /* Long argument lists may need more than the first stack page,
+     which page faults below add when they see this */
+  thread_current()->user_esp = esp;
+#endif
+
   /* setup return address and argument count */
   esp->ret = 0x00; // Or NULL?
   esp->argc = argc;
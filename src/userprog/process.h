@@ -7,6 +7,7 @@ extern struct plist PROCESS_LIST;
 
 void process_init (void);
 void process_print_list (void);
+void process_print_stats (void);
 void process_exit (int status);
 tid_t process_execute (const char *file_name);
 int process_wait (tid_t);
@@ -13,7 +13,13 @@
 #include "userprog/pagedir.h"
 #include "userprog/process.h"
 #include "devices/input.h"
+#include "devices/timer.h"
 #include "userprog/plist.h"
+#include "userprog/futex.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 static void syscall_handler (struct intr_frame *);
 
@@ -21,6 +27,7 @@ void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  futex_init ();
 }
 
 
@@ -36,10 +43,12 @@ syscall_init (void)
 const int argc[] = {
   /* basic calls */
   0, 1, 1, 1, 2, 1, 1, 1, 3, 3, 2, 1, 1, 
+  /* plist, sleep */
+  0, 1,
   /* not implemented */
   2, 1,    1, 1, 2, 1, 1,
   /* extended */
-  0
+  1, 3, 3
 };
 
 static void
@@ -47,6 +56,11 @@ syscall_handler (struct intr_frame *f)
 {
   int32_t* esp = (int32_t*)f->esp;
 
+#ifdef VM
+  /* Page faults in here need this to tell whether to grow the stack */
+  thread_current()->user_esp = f->esp;
+#endif
+
   //  if(!verify_fix_length(esp, sizeof(esp)) || !is_user_vaddr(esp))
   //    {
       //      sys_exit(-1, f);
@@ -114,6 +128,23 @@ syscall_handler (struct intr_frame *f)
   case SYS_FILESIZE:
     sys_filesize(esp[1],f);
     break;
+  case SYS_CLOCK_GETTIME:
+    sys_clock_gettime((int64_t*)esp[1], f);
+    break;
+  case SYS_FUTEX_WAIT:
+    sys_futex_wait(esp[1], esp[2], esp[3], f);
+    break;
+  case SYS_FUTEX_WAKE:
+    sys_futex_wake(esp[1], esp[2], esp[3], f);
+    break;
+#ifdef VM
+  case SYS_MMAP:
+    sys_mmap(esp[1], (void*)esp[2], f);
+    break;
+  case SYS_MUNMAP:
+    sys_munmap(esp[1]);
+    break;
+#endif
   default:
     printf ("# Executed an unknown system call!\n");
     printf ("# Stack top + 0: %d\n", esp[0]);
@@ -214,7 +245,7 @@ sys_read(int fd, char *buffer, unsigned length, struct intr_frame* f)
   for(i = 0; i < length; ++i)
     {
       if(buf == NULL || !is_user_vaddr(buf) || 
-	 pagedir_get_page(thread_current()->pagedir, buf) == NULL )
+	 pagedir_get_user_page(buf) == NULL )
 	{
 	  process_exit(-1);
 	  thread_exit();
@@ -255,7 +286,17 @@ sys_read(int fd, char *buffer, unsigned length, struct intr_frame* f)
       if (fp == NULL)
 	f->eax = -1;
       else
-	f->eax = file_read(fp, buffer, length);
+	{
+#ifdef VM
+	  /* Keep the buffer in memory while the file system copies into it */
+	  if(!page_pin(buffer, length))
+	    sys_exit(-1, f);
+#endif
+	  f->eax = file_read(fp, buffer, length);
+#ifdef VM
+	  page_unpin(buffer, length);
+#endif
+	}
     }
   
   return;
@@ -288,7 +329,15 @@ sys_write(int fd, const char *buffer, unsigned length, struct intr_frame* f)
 	  f->eax = -1;
 	  return;
 	}
+#ifdef VM
+      /* Keep the buffer in memory while the file system copies from it */
+      if(!page_pin(buffer, length))
+	sys_exit(-1, f);
+#endif
       f->eax = file_write( fp, buffer, length);
+#ifdef VM
+      page_unpin(buffer, length);
+#endif
     }
   
   return;
@@ -381,3 +430,72 @@ sys_filesize(int fd, struct intr_frame* f)
   else
     f->eax = -1;
 }
+
+/*
+ * Stores the number of nanoseconds since boot in *ns
+ */
+void
+sys_clock_gettime(int64_t* ns, struct intr_frame* f)
+{
+  if(!verify_fix_length(ns, sizeof(*ns)))
+    sys_exit(-1, f);
+
+  *ns = timer_ns();
+  f->eax = 0;
+}
+
+/*
+ * Blocks until woken by futex_wake if the int at @offset in file @fd
+ * still holds @expected. Returns 0 when woken, -1 at once otherwise
+ */
+void
+sys_futex_wait(int fd, unsigned offset, int expected, struct intr_frame* f)
+{
+  struct file* fp = map_find(&(thread_current()->file_list), fd);
+
+  if ( fp != NULL )
+    f->eax = futex_wait(fp, offset, expected);
+  else
+    f->eax = -1;
+}
+
+/*
+ * Wakes up to @count processes blocked on the int at @offset in file
+ * @fd. Returns the number woken
+ */
+void
+sys_futex_wake(int fd, unsigned offset, int count, struct intr_frame* f)
+{
+  struct file* fp = map_find(&(thread_current()->file_list), fd);
+
+  if ( fp != NULL )
+    f->eax = futex_wake(fp, offset, count);
+  else
+    f->eax = -1;
+}
+
+#ifdef VM
+/*
+ * Maps the file open as @fd into memory at @addr. Returns the mapping
+ * id, or -1 if it cannot be mapped there
+ */
+void
+sys_mmap(int fd, void* addr, struct intr_frame* f)
+{
+  struct file* fp = map_find(&(thread_current()->file_list), fd);
+
+  if ( fp != NULL )
+    f->eax = mmap_map(fp, addr);
+  else
+    f->eax = -1;
+}
+
+/*
+ * Removes mapping @mapid, writing back the pages that were changed
+ */
+void
+sys_munmap(int mapid)
+{
+  mmap_unmap(mapid);
+}
+#endif
@@ -18,4 +18,11 @@ void sys_create(const char*, unsigned, struct intr_frame*);
 void sys_seek(int, unsigned);
 void sys_tell(int, struct intr_frame*);
 void sys_filesize(int, struct intr_frame*);
+void sys_clock_gettime(int64_t*, struct intr_frame*);
+void sys_futex_wait(int, unsigned, int, struct intr_frame*);
+void sys_futex_wake(int, unsigned, int, struct intr_frame*);
+#ifdef VM
+void sys_mmap(int, void*, struct intr_frame*);
+void sys_munmap(int);
+#endif
 #endif /* userprog/syscall.h */
@@ -0,0 +1,270 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* Frame table.
+
+   Every page of the user pool that holds a process's page has
+   a struct frame on the `frames' list.  When palloc_get_page()
+   has no user page left to give, frame_alloc() takes one away
+   from a process instead, choosing it with the second-chance
+   "clock" algorithm: the clock hand sweeps around `frames',
+   clearing the accessed bit of each page it passes, and stops
+   at the first page that has not been accessed since the last
+   sweep.  A dirty page is written to swap, or back to its file
+   if it belongs to a memory mapping; a clean one is just
+   dropped, since it can be read again from its file, from its
+   swap slot, or is all zeros.
+
+   A frame is pinned from the time it is allocated until the
+   page is in it and mapped, so that it is not evicted while it
+   is being loaded.
+
+   The CPUs do not shoot down each other's TLB entries, so a
+   page is only evicted while its owner is not running on
+   another CPU: once the page is unmapped, the owner reloads its
+   page directory, and with it the TLB, before it runs again.
+
+   `frame_lock' is held for the whole of an eviction, including
+   writing the page out, so that the owner of the page cannot fault it
+   back in until the eviction is done.  The owner must check under
+   the lock whether the page still has a frame before it allocates
+   another one (see page_load()), since an eviction that gives up
+   maps the page again. */
+
+static struct list frames;              /* All frames. */
+static struct list_elem *hand;          /* Clock hand. */
+static size_t frame_cnt;                /* # of frames on `frames'. */
+static struct lock frame_lock;          /* Protects all of the above. */
+
+/* Statistics. */
+static long long evict_cnt;             /* # of pages evicted. */
+static long long dirty_cnt;             /* # of them written to swap. */
+static long long mmap_cnt;              /* # of them written to files. */
+static long long fail_cnt;              /* # of times no page was found. */
+
+static struct frame *evict (void);
+static bool page_out (struct frame *);
+static bool owner_idle (struct frame *);
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  hand = list_end (&frames);
+  lock_init_named (&frame_lock, "frame_lock");
+}
+
+/* Allocates a frame for page P of the running process, evicting
+   another page if the user pool is exhausted, and zeroes it if
+   ZERO is true.  Sets P's frame.  The frame is returned pinned;
+   call frame_unpin() once P is mapped.  Returns a null pointer
+   if no frame can be had. */
+struct frame *
+frame_alloc (struct page *p, bool zero)
+{
+  struct frame *f = NULL;
+  void *kpage;
+
+  kpage = palloc_get_page (PAL_USER | (zero ? PAL_ZERO : 0));
+  if (kpage != NULL)
+    {
+      f = malloc_tagged (sizeof *f, MALLOC_VM);
+      if (f == NULL)
+        {
+          palloc_free_page (kpage);
+          return NULL;
+        }
+      f->kpage = kpage;
+    }
+
+  lock_acquire (&frame_lock);
+  ASSERT (p->frame == NULL);
+  if (f != NULL)
+    {
+      list_push_back (&frames, &f->elem);
+      frame_cnt++;
+    }
+  else
+    {
+      f = evict ();
+      if (f != NULL)
+        palloc_recharge (f->owner, thread_current (), 1);
+    }
+  if (f != NULL)
+    {
+      f->page = p;
+      f->owner = thread_current ();
+      f->pinned = true;
+      p->frame = f;
+    }
+  else
+    fail_cnt++;
+  lock_release (&frame_lock);
+
+  if (f != NULL && kpage == NULL && zero)
+    memset (f->kpage, 0, PGSIZE);
+  return f;
+}
+
+/* Keeps the frame holding page P of the running process from
+   being evicted, waiting for an eviction in progress to finish.
+   Returns true if successful, false if P is not in memory. */
+bool
+frame_pin (struct page *p)
+{
+  bool pinned = false;
+
+  lock_acquire (&frame_lock);
+  if (p->frame != NULL)
+    {
+      p->frame->pinned = true;
+      pinned = true;
+    }
+  lock_release (&frame_lock);
+  return pinned;
+}
+
+/* Lets frame F be evicted. */
+void
+frame_unpin (struct frame *f)
+{
+  lock_acquire (&frame_lock);
+  f->pinned = false;
+  lock_release (&frame_lock);
+}
+
+/* Unmaps page P of the running process and frees its frame, if
+   it has one. */
+void
+frame_free (struct page *p)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  f = p->frame;
+  if (f != NULL)
+    {
+      ASSERT (f->owner == thread_current ());
+
+      pagedir_clear_page (f->owner->pagedir, p->upage);
+      if (hand == &f->elem)
+        hand = list_next (hand);
+      list_remove (&f->elem);
+      frame_cnt--;
+      p->frame = NULL;
+      palloc_free_page (f->kpage);
+      free (f);
+    }
+  lock_release (&frame_lock);
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %zu in use, %lld evicted "
+          "(%lld to swap, %lld to files), %lld times none to evict\n",
+          frame_cnt, evict_cnt, dirty_cnt, mmap_cnt, fail_cnt);
+}
+
+/* Chooses a frame with the clock algorithm, evicts its page, and
+   returns it, or returns a null pointer if every frame is pinned
+   or in use on another CPU, or swap is full. */
+static struct frame *
+evict (void)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  /* Two sweeps clear every accessed bit, so a frame that can be
+     evicted at all is found by then. */
+  for (i = 0; i < 2 * frame_cnt; i++)
+    {
+      struct frame *f;
+      uint32_t *pd;
+
+      if (hand == list_end (&frames))
+        hand = list_begin (&frames);
+      f = list_entry (hand, struct frame, elem);
+      hand = list_next (hand);
+
+      if (f->pinned || !owner_idle (f))
+        continue;
+      pd = f->owner->pagedir;
+      if (pagedir_is_accessed (pd, f->page->upage))
+        pagedir_set_accessed (pd, f->page->upage, false);
+      else if (page_out (f))
+        {
+          evict_cnt++;
+          return f;
+        }
+    }
+  return NULL;
+}
+
+/* Unmaps the page in frame F, writing it to swap or to its file
+   if it is dirty.  Returns true if successful, false if F's owner
+   started running meanwhile or swap is full, in which case the
+   page is left in place. */
+static bool
+page_out (struct frame *f)
+{
+  struct page *p = f->page;
+  uint32_t *pd = f->owner->pagedir;
+  bool dirty;
+
+  pagedir_clear_page (pd, p->upage);
+
+  /* The owner may have been scheduled on another CPU just before
+     the page was unmapped, with its old mapping in the TLB.  Make
+     the unmapping visible before checking. */
+  asm volatile ("lock; addl $0, (%%esp)" : : : "memory");
+  dirty = pagedir_is_dirty (pd, p->upage);
+  if (!owner_idle (f))
+    goto restore;
+
+  if (dirty && p->mmap)
+    {
+      file_write_at (p->file, f->kpage, p->read_bytes, p->ofs);
+      mmap_cnt++;
+    }
+  else if (dirty)
+    {
+      if (p->swap_slot == SWAP_NONE)
+        p->swap_slot = swap_alloc ();
+      if (p->swap_slot == SWAP_NONE)
+        goto restore;
+      swap_write (p->swap_slot, f->kpage);
+      dirty_cnt++;
+    }
+  p->frame = NULL;
+  return true;
+
+ restore:
+  pagedir_set_page (pd, p->upage, f->kpage, p->writable);
+  if (dirty)
+    pagedir_set_dirty (pd, p->upage, true);
+  return false;
+}
+
+/* Returns true if the owner of frame F is not running on another
+   CPU, so that F can be unmapped without leaving a stale TLB
+   entry behind. */
+static bool
+owner_idle (struct frame *f)
+{
+  return f->owner == thread_current () || f->owner->status != THREAD_RUNNING;
+}
@@ -0,0 +1,27 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <list.h>
+#include <stdbool.h>
+
+struct page;
+struct thread;
+
+/* A page of the user pool that holds a user page. */
+struct frame
+  {
+    struct list_elem elem;              /* Element in `frames'. */
+    void *kpage;                        /* Kernel virtual address. */
+    struct page *page;                  /* Page held. */
+    struct thread *owner;               /* Process that owns PAGE. */
+    bool pinned;                        /* Not to be evicted? */
+  };
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *, bool zero);
+bool frame_pin (struct page *);
+void frame_unpin (struct frame *);
+void frame_free (struct page *);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
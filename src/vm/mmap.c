@@ -0,0 +1,149 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Memory-mapped files.
+
+   A mapping is a run of pages in the supplemental page table,
+   one for each page of the file, that are loaded from the file
+   on demand like the pages of an executable.  A page that has
+   been modified is written back to the file when it is evicted,
+   when the mapping is removed, or when the process exits, so a
+   program can work on a file without copying it through a
+   buffer with read() and write().
+
+   Each mapping has its own reopened file, so closing the file
+   descriptor it was made from does not affect it. */
+
+/* One memory mapping of a process. */
+struct mapping
+  {
+    struct list_elem elem;              /* Element in thread's `mappings'. */
+    int mapid;                          /* Mapping identifier. */
+    struct file *file;                  /* File mapped. */
+    uint8_t *base;                      /* Start of the mapping. */
+    size_t page_cnt;                    /* Number of pages mapped. */
+  };
+
+static void unmap (struct mapping *);
+
+/* Initializes the running process's list of mappings.  Called
+   by load() right after the supplemental page table is
+   created. */
+void
+mmap_table_init (void)
+{
+  struct thread *t = thread_current ();
+
+  list_init (&t->mappings);
+  t->next_mapid = 0;
+}
+
+/* Removes all of the running process's mappings, writing back
+   their modified pages.  Must be called before the supplemental
+   page table is destroyed. */
+void
+mmap_table_destroy (void)
+{
+  struct thread *t = thread_current ();
+
+  /* A process whose load failed early has no list. */
+  if (t->page_table == NULL)
+    return;
+  while (!list_empty (&t->mappings))
+    unmap (list_entry (list_front (&t->mappings), struct mapping, elem));
+}
+
+/* Maps FILE into the running process's memory starting at ADDR.
+   Returns the new mapping's identifier, or -1 if FILE is empty,
+   ADDR is not page-aligned or is null, the mapping would overlap
+   pages already in use or the stack_page_limit pages below
+   PHYS_BASE that the stack may grow into, or memory is short. */
+int
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length = file_length (file);
+  uint8_t *stack_bottom = (uint8_t *) PHYS_BASE - stack_page_limit * PGSIZE;
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0 || length <= 0
+      || !is_user_vaddr (addr) || (uint8_t *) addr >= stack_bottom
+      || (size_t) (stack_bottom - (uint8_t *) addr)
+         < ROUND_UP ((size_t) length, PGSIZE))
+    return -1;
+
+  m = malloc_tagged (sizeof *m, MALLOC_VM);
+  if (m == NULL)
+    return -1;
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return -1;
+    }
+  m->base = addr;
+  m->page_cnt = 0;
+
+  for (i = 0; i * PGSIZE < (size_t) length; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (!page_add_mmap (m->base + ofs, m->file, ofs, read_bytes))
+        {
+          for (i = 0; i < m->page_cnt; i++)
+            page_remove (m->base + i * PGSIZE);
+          file_close (m->file);
+          free (m);
+          return -1;
+        }
+      m->page_cnt++;
+    }
+
+  m->mapid = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->mapid;
+}
+
+/* Removes the running process's mapping MAPID, writing back its
+   modified pages.  Returns true if successful, false if there is
+   no such mapping. */
+bool
+mmap_unmap (int mapid)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->mappings); e != list_end (&t->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->mapid == mapid)
+        {
+          unmap (m);
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Removes mapping M, writing back its modified pages. */
+static void
+unmap (struct mapping *m)
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove (m->base + i * PGSIZE);
+  list_remove (&m->elem);
+  file_close (m->file);
+  free (m);
+}
@@ -0,0 +1,366 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Supplemental page table.
+
+   load() used to read every page of an executable into memory
+   before the process ran, so exec took time in proportion to
+   the size of the binary even if most of its code was never
+   run.  Instead, load_segment() now only records where each
+   page comes from, in a hash table per process keyed on the
+   user page, and the page fault handler calls page_load() to
+   bring a page in the first time it is touched.  After that,
+   the page may be evicted and brought back in again any number
+   of times (see vm/frame.c).
+
+   The stack starts out as one page, and grows a page at a time
+   when the process touches the page just below it; see
+   page_grow_stack().
+
+   The executable stays open for as long as the process runs,
+   as the thread's `exec_file', and is closed by
+   page_table_destroy(). */
+
+/* PUSHA, the instruction that pushes the most at once, writes
+   as far as this many bytes below the stack pointer before it
+   is decremented. */
+#define STACK_SLOP 32
+
+/* Most pages a user stack may grow to.
+   Set with the -sl kernel command line option. */
+size_t stack_page_limit = 2048;
+
+/* Statistics. */
+static long long file_page_cnt;         /* # of pages read from files. */
+static long long zero_page_cnt;         /* # of pages zero-filled. */
+static long long stack_page_cnt;        /* # of pages added to stacks. */
+static long long mmap_write_cnt;        /* # of mapped pages written back. */
+static long long unused_page_cnt;       /* # of pages never touched. */
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destroy;
+static bool add_page (void *upage, struct file *, off_t ofs,
+                      size_t read_bytes, bool writable, bool mmap);
+static void release_page (struct page *);
+static struct page *page_lookup (const void *upage);
+
+/* Creates an empty supplemental page table for the running
+   process.  Returns true if successful, false if out of
+   memory. */
+bool
+page_table_create (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->page_table == NULL);
+
+  t->page_table = malloc_tagged (sizeof *t->page_table, MALLOC_VM);
+  if (t->page_table == NULL)
+    return false;
+  hash_init (t->page_table, page_hash, page_less, NULL);
+  return true;
+}
+
+/* Destroys the running process's supplemental page table,
+   freeing its frames and swap slots, and closes its executable.
+   Must be called before the page directory is destroyed. */
+void
+page_table_destroy (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->page_table != NULL)
+    {
+      hash_destroy (t->page_table, page_destroy);
+      free (t->page_table);
+      t->page_table = NULL;
+    }
+  file_close (t->exec_file);
+  t->exec_file = NULL;
+}
+
+/* Records that user page UPAGE is to be loaded with READ_BYTES
+   bytes from FILE starting at offset OFS, followed by zeros, the
+   first time it is touched.  FILE must stay open until the
+   process exits.  Returns true if successful, false if UPAGE is
+   already in the table or out of memory. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable)
+{
+  return add_page (upage, file, ofs, read_bytes, writable, false);
+}
+
+/* Records that user page UPAGE maps READ_BYTES bytes of FILE
+   starting at offset OFS, followed by zeros.  The page is loaded
+   the first time it is touched, and if it has been modified, it
+   is written back to FILE when it is evicted or removed.  FILE
+   must stay open until the page is removed.  Returns true if
+   successful, false if UPAGE is already in the table or out of
+   memory. */
+bool
+page_add_mmap (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes)
+{
+  return add_page (upage, file, ofs, read_bytes, true, true);
+}
+
+/* Removes user page UPAGE from the running process, writing it
+   back first if it belongs to a memory mapping and has been
+   modified.  Returns true if successful, false if UPAGE is not
+   in the table. */
+bool
+page_remove (void *upage)
+{
+  struct page *p = page_lookup (upage);
+
+  if (p == NULL)
+    return false;
+  release_page (p);
+  hash_delete (thread_current ()->page_table, &p->hash_elem);
+  free (p);
+  return true;
+}
+
+/* Adds a page to the running process's table, as described for
+   page_add_file() and page_add_mmap(). */
+static bool
+add_page (void *upage, struct file *file, off_t ofs,
+          size_t read_bytes, bool writable, bool mmap)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = malloc_tagged (sizeof *p, MALLOC_VM);
+  if (p == NULL)
+    return false;
+  p->upage = upage;
+  p->writable = writable;
+  p->loaded = false;
+  p->mmap = mmap;
+  p->frame = NULL;
+  p->swap_slot = SWAP_NONE;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  if (hash_insert (t->page_table, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return false;
+    }
+  return true;
+}
+
+/* Brings in the page containing user address UADDR, if the
+   running process has one recorded there.  Returns true if the
+   page is now mapped, false if UADDR is not in the table or the
+   page could not be loaded. */
+bool
+page_load (const void *uaddr)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+  struct frame *f;
+
+  if (t->page_table == NULL || !is_user_vaddr (uaddr))
+    return false;
+  p = page_lookup (pg_round_down (uaddr));
+  if (p == NULL)
+    return false;
+  if (pagedir_get_page (t->pagedir, p->upage) != NULL)
+    return true;
+
+  /* The page may be unmapped only because an eviction is in
+     progress, which will map it again if it gives up.
+     frame_pin() waits for the eviction to finish.  If the page
+     has no frame after that, it stays that way, and its swap
+     slot stays put, until this thread brings it in. */
+  if (frame_pin (p))
+    {
+      frame_unpin (p->frame);
+      return true;
+    }
+
+  f = frame_alloc (p, p->swap_slot == SWAP_NONE && p->read_bytes == 0);
+  if (f == NULL)
+    return false;
+  if (p->swap_slot != SWAP_NONE)
+    swap_read (p->swap_slot, f->kpage);
+  else if (p->read_bytes > 0)
+    {
+      if (file_read_at (p->file, f->kpage, p->read_bytes, p->ofs)
+          != (int) p->read_bytes)
+        {
+          frame_free (p);
+          return false;
+        }
+      memset ((uint8_t *) f->kpage + p->read_bytes, 0,
+              PGSIZE - p->read_bytes);
+      file_page_cnt++;
+    }
+  else
+    zero_page_cnt++;
+  if (!pagedir_set_page (t->pagedir, p->upage, f->kpage, p->writable))
+    {
+      frame_free (p);
+      return false;
+    }
+  p->loaded = true;
+  frame_unpin (f);
+  return true;
+}
+
+/* Brings in the SIZE bytes of user memory starting at UADDR,
+   growing the stack if needed, and keeps them in memory until
+   page_unpin() is called.  Lets the file system copy to or from
+   a user buffer without faulting while it holds its locks.
+   Returns true if successful, false if part of the buffer is not
+   valid user memory, in which case nothing is left pinned. */
+bool
+page_pin (const void *uaddr, size_t size)
+{
+  const uint8_t *start = pg_round_down (uaddr);
+  const uint8_t *end = (const uint8_t *) uaddr + size;
+  const uint8_t *upage;
+
+  if (size == 0)
+    return true;
+  for (upage = start; upage < end; upage += PGSIZE)
+    for (;;)
+      {
+        struct page *p = page_lookup (upage);
+
+        if (p != NULL && frame_pin (p))
+          break;
+        if (!page_load (upage)
+            && !page_grow_stack (upage, thread_current ()->user_esp))
+          {
+            if (upage > start)
+              page_unpin (start, upage - start);
+            return false;
+          }
+      }
+  return true;
+}
+
+/* Lets the SIZE bytes of user memory starting at UADDR, which
+   must have been pinned with page_pin(), be evicted again. */
+void
+page_unpin (const void *uaddr, size_t size)
+{
+  const uint8_t *end = (const uint8_t *) uaddr + size;
+  const uint8_t *upage;
+
+  if (size == 0)
+    return;
+  for (upage = pg_round_down (uaddr); upage < end; upage += PGSIZE)
+    frame_unpin (page_lookup (upage)->frame);
+}
+
+/* Grows the running process's stack to cover user address
+   UADDR, given that its stack pointer is ESP, if UADDR looks like
+   a stack access: no more than STACK_SLOP bytes below ESP and
+   within stack_page_limit pages of the top of the stack.  The new
+   page is zeroed and mapped.  Returns true if successful, false
+   if UADDR is not a stack access or out of memory. */
+bool
+page_grow_stack (const void *uaddr, const void *esp)
+{
+  uint8_t *upage = pg_round_down (uaddr);
+
+  if (!is_user_vaddr (uaddr)
+      || (const uint8_t *) uaddr + STACK_SLOP < (const uint8_t *) esp
+      || (size_t) ((uint8_t *) PHYS_BASE - upage) > stack_page_limit * PGSIZE)
+    return false;
+  if (!page_add_file (upage, NULL, 0, 0, true) || !page_load (upage))
+    return false;
+
+  stack_page_cnt++;
+  return true;
+}
+
+/* Prints demand paging statistics. */
+void
+page_print_stats (void)
+{
+  printf ("Paging: %lld pages read from files, %lld zero-filled, "
+          "%lld never touched, %lld added to stacks, "
+          "%lld mapped pages written back\n",
+          file_page_cnt, zero_page_cnt, unused_page_cnt, stack_page_cnt,
+          mmap_write_cnt);
+}
+
+/* Returns the running process's entry for UPAGE, or a null
+   pointer if it has none. */
+static struct page *
+page_lookup (const void *upage)
+{
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = (void *) upage;
+  e = hash_find (thread_current ()->page_table, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Returns a hash value for page E. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->upage < b->upage;
+}
+
+/* Frees page E, counting it if it was never loaded. */
+static void
+page_destroy (struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *p = hash_entry (e, struct page, hash_elem);
+
+  release_page (p);
+  if (!p->loaded)
+    unused_page_cnt++;
+  free (p);
+}
+
+/* Frees page P's frame and swap slot.  If P belongs to a memory
+   mapping and has been modified, writes it back to its file
+   first, keeping it pinned meanwhile so that it cannot be
+   evicted and written back twice. */
+static void
+release_page (struct page *p)
+{
+  if (p->mmap && frame_pin (p)
+      && pagedir_is_dirty (thread_current ()->pagedir, p->upage))
+    {
+      file_write_at (p->file, p->frame->kpage, p->read_bytes, p->ofs);
+      mmap_write_cnt++;
+    }
+  frame_free (p);
+  if (p->swap_slot != SWAP_NONE)
+    swap_free (p->swap_slot);
+}
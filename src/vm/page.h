@@ -0,0 +1,51 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct file;
+struct frame;
+
+/* A user page of a process, where it is, and where to get its
+   contents when it is not in memory. */
+struct page
+  {
+    struct hash_elem hash_elem;         /* Element in thread's table. */
+    void *upage;                        /* User virtual address. */
+    bool writable;                      /* Mapped writable? */
+    bool loaded;                        /* Ever been in memory? */
+    bool mmap;                          /* Part of a memory mapping? */
+    struct frame *frame;                /* Frame holding it, or null. */
+    size_t swap_slot;                   /* Swap slot, or SWAP_NONE. */
+
+    /* Until the page has a swap slot, its first READ_BYTES bytes
+       come from FILE at offset OFS and the rest of it is zeroed.
+       READ_BYTES is 0 for a page that is all zeros, in which case
+       FILE is unused.  Once written to swap, the page is always
+       read back from its slot.  A page of a memory mapping is
+       written back to FILE instead of to swap. */
+    struct file *file;
+    off_t ofs;
+    size_t read_bytes;
+  };
+
+/* Most pages a user stack may grow to. */
+extern size_t stack_page_limit;
+
+bool page_table_create (void);
+void page_table_destroy (void);
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes, bool writable);
+bool page_add_mmap (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes);
+bool page_remove (void *upage);
+bool page_load (const void *uaddr);
+bool page_pin (const void *uaddr, size_t size);
+void page_unpin (const void *uaddr, size_t size);
+bool page_grow_stack (const void *uaddr, const void *esp);
+void page_print_stats (void);
+
+#endif /* vm/page.h */
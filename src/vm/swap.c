@@ -0,0 +1,112 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "devices/disk.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Swap space.
+
+   The swap disk (hd1:1, the one `pintos --swap-disk' creates)
+   is divided into page-sized slots of SECTORS_PER_SLOT sectors
+   each, with one bit per slot saying whether it is in use.  A
+   page is always read or written as a whole. */
+
+/* Number of sectors in a swap slot. */
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
+
+static struct disk *swap_disk;          /* Swap disk, or null. */
+static struct bitmap *swap_slots;       /* One bit per slot, true if used. */
+static size_t used_cnt;                 /* # of slots in use. */
+static struct lock swap_lock;           /* Protects the above. */
+
+/* Statistics. */
+static long long read_cnt;              /* # of pages read from swap. */
+static long long write_cnt;             /* # of pages written to swap. */
+static size_t peak_cnt;                 /* Most slots ever in use. */
+
+/* Initializes swap space.  Without a swap disk, there are no
+   slots and swap_alloc() always fails. */
+void
+swap_init (void)
+{
+  size_t slot_cnt = 0;
+
+  swap_disk = disk_get (1, 1);
+  if (swap_disk != NULL)
+    slot_cnt = disk_size (swap_disk) / SECTORS_PER_SLOT;
+  else
+    printf ("swap: no swap disk, pages cannot be swapped out\n");
+
+  swap_slots = bitmap_create (slot_cnt);
+  if (swap_slots == NULL)
+    PANIC ("bitmap creation failed--swap disk is too large");
+  lock_init_named (&swap_lock, "swap_lock");
+}
+
+/* Allocates a swap slot and returns its index, or SWAP_NONE if
+   swap space is full. */
+size_t
+swap_alloc (void)
+{
+  size_t slot;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (swap_slots, 0, 1, false);
+  if (slot != BITMAP_ERROR && ++used_cnt > peak_cnt)
+    peak_cnt = used_cnt;
+  lock_release (&swap_lock);
+
+  return slot != BITMAP_ERROR ? slot : SWAP_NONE;
+}
+
+/* Makes swap slot SLOT available for use again. */
+void
+swap_free (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_slots, slot));
+  bitmap_reset (swap_slots, slot);
+  used_cnt--;
+  lock_release (&swap_lock);
+}
+
+/* Reads swap slot SLOT into page KPAGE. */
+void
+swap_read (size_t slot, void *kpage)
+{
+  uint8_t *buffer = kpage;
+  disk_sector_t sector = slot * SECTORS_PER_SLOT;
+  int i;
+
+  ASSERT (slot < bitmap_size (swap_slots));
+
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    disk_read (swap_disk, sector + i, buffer + i * DISK_SECTOR_SIZE);
+  read_cnt++;
+}
+
+/* Writes page KPAGE to swap slot SLOT. */
+void
+swap_write (size_t slot, const void *kpage)
+{
+  const uint8_t *buffer = kpage;
+  disk_sector_t sector = slot * SECTORS_PER_SLOT;
+  int i;
+
+  ASSERT (slot < bitmap_size (swap_slots));
+
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    disk_write (swap_disk, sector + i, buffer + i * DISK_SECTOR_SIZE);
+  write_cnt++;
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  printf ("Swap: %zu slots, %zu peak in use, "
+          "%lld pages written, %lld read\n",
+          bitmap_size (swap_slots), peak_cnt, write_cnt, read_cnt);
+}
@@ -0,0 +1,17 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* A swap slot index, or SWAP_NONE. */
+#define SWAP_NONE SIZE_MAX
+
+void swap_init (void);
+size_t swap_alloc (void);
+void swap_free (size_t slot);
+void swap_read (size_t slot, void *kpage);
+void swap_write (size_t slot, const void *kpage);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */